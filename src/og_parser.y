@@ -190,9 +190,9 @@ fvars : svars { $$ = $1; }
     | auto_t var_idents  '=' exprs { $$ = new og::variable_declaration_node(LINE, tPRIVATE, $1, *$2, new og::tuple_node($4)); delete $2; }
     ;
 
-iter_instr : tFOR fvars ';' exprs ';' exprs tDO instr    { $$ = new og::for_node(LINE, $2, new og::tuple_node($4), $6, $8); }
+iter_instr : tFOR fvars ';' exprs ';' exprs tDO instr    { $$ = new og::for_node(LINE, $2, new og::tuple_node($4), new og::evaluation_node(new og::tuple_node($6)), $8); }
            | tFOR fvars ';' exprs ';'       tDO instr    { $$ = new og::for_node(LINE, $2, new og::tuple_node($4), nullptr, $7); }
-           | tFOR fvars ';'       ';' exprs tDO instr    { $$ = new og::for_node(LINE, $2, nullptr, $5, $7); }
+           | tFOR fvars ';'       ';' exprs tDO instr    { $$ = new og::for_node(LINE, $2, nullptr, new og::evaluation_node(new og::tuple_node($5)), $7); }
            | tFOR fvars ';'       ';'       tDO instr    { $$ = new og::for_node(LINE, $2, nullptr, nullptr, $6); }
            | tFOR exprs ';' exprs ';' exprs tDO instr    { $$ = new og::for_node(LINE, new og::evaluation_node(new og::tuple_node($2)), new og::tuple_node($4), new og::evaluation_node(new og::tuple_node($6)), $8); }
            | tFOR exprs ';' exprs ';'       tDO instr    { $$ = new og::for_node(LINE, new og::evaluation_node(new og::tuple_node($2)), new og::tuple_node($4), nullptr, $7); }
@@ -0,0 +1,32 @@
+#include "targets/constant_division.h"
+
+og::division_magic::division_magic(int divisor) {
+  const unsigned two31 = 0x80000000u;
+  unsigned ad = divisor < 0 ? 0u - (unsigned)divisor : (unsigned)divisor;
+  unsigned t = two31 + ((unsigned)divisor >> 31);
+  unsigned anc = t - 1 - t % ad; // absolute value of nc
+  int p = 31;
+  unsigned q1 = two31 / anc, r1 = two31 - q1 * anc; // 2^p / |nc| and its remainder
+  unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;   // 2^p / |d| and its remainder
+  unsigned delta;
+  do {
+    p++;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc) {
+      q1++;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad) {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+
+  multiplier = (int)(q2 + 1);
+  if (divisor < 0) multiplier = -multiplier;
+  shift = p - 32;
+}
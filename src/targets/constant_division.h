@@ -0,0 +1,29 @@
+#ifndef __OG_TARGETS_CONSTANT_DIVISION_H__
+#define __OG_TARGETS_CONSTANT_DIVISION_H__
+
+namespace og {
+
+  /**
+   * Signed division by a constant d (|d| >= 2) as a multiplication: the
+   * quotient of n / d is the high word of multiplier * n, plus n when d > 0
+   * and the multiplier is negative (minus n when d < 0 and it is positive),
+   * shifted right (arithmetic) by shift, plus one when that is negative.
+   * See Hacker's Delight, section 10-4.
+   */
+  struct division_magic {
+    int multiplier;
+    int shift;
+
+    explicit division_magic(int divisor);
+
+    /** Whether the quotient needs n added (1), subtracted (-1) or neither (0) after the multiplication. */
+    int correction(int divisor) const {
+      if (divisor > 0 && multiplier < 0) return 1;
+      if (divisor < 0 && multiplier > 0) return -1;
+      return 0;
+    }
+  };
+
+} // og
+
+#endif
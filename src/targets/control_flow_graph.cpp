@@ -0,0 +1,368 @@
+#include <string>
+#include <functional>
+#include "targets/control_flow_graph.h"
+#include "ast/all.h"
+
+//---------------------------------------------------------------------------
+//     GRAPH
+//---------------------------------------------------------------------------
+
+size_t og::control_flow_graph::new_block() {
+  _blocks.push_back(basic_block{_blocks.size(), {}, {}, {}});
+  return _blocks.size() - 1;
+}
+
+void og::control_flow_graph::add_edge(size_t from, size_t to) {
+  _blocks[from].successors.push_back(to);
+  _blocks[to].predecessors.push_back(from);
+}
+
+size_t og::control_flow_graph::new_variable(const std::string &name) {
+  _variables.push_back(name);
+  return _variables.size() - 1;
+}
+
+std::vector<bool> og::control_flow_graph::reachable() const {
+  std::vector<bool> seen(_blocks.size(), false);
+  std::vector<size_t> worklist{entry()};
+  seen[entry()] = true;
+
+  while (!worklist.empty()) {
+    size_t b = worklist.back();
+    worklist.pop_back();
+    for (size_t succ : _blocks[b].successors) {
+      if (!seen[succ]) {
+        seen[succ] = true;
+        worklist.push_back(succ);
+      }
+    }
+  }
+
+  return seen;
+}
+
+std::vector<size_t> og::control_flow_graph::reverse_postorder() const {
+  std::vector<size_t> order;
+  std::vector<bool> seen(_blocks.size(), false);
+
+  std::function<void(size_t)> visit = [&](size_t b) {
+    seen[b] = true;
+    for (size_t succ : _blocks[b].successors) {
+      if (!seen[succ]) visit(succ);
+    }
+    order.push_back(b);
+  };
+  visit(entry());
+
+  // unreachable blocks go last, they don't affect reachable ones
+  for (size_t b = 0; b < _blocks.size(); b++) {
+    if (!seen[b]) order.insert(order.begin(), b);
+  }
+
+  return std::vector<size_t>(order.rbegin(), order.rend());
+}
+
+//---------------------------------------------------------------------------
+//     BUILDER
+//---------------------------------------------------------------------------
+
+// nodes that are visited outside of a statement become statements of their own
+#define PLACE_STATEMENT if (!_statement) { append(node, lvl); return; }
+
+void og::control_flow_graph_builder::append(cdk::basic_node * const node, int lvl) {
+  auto &statements = _cfg.block(_current).statements;
+  statements.push_back(cfg_statement{node, {}, {}});
+  _statement = &statements.back();
+  node->accept(this, lvl);
+  _statement = nullptr;
+}
+
+void og::control_flow_graph_builder::jump(size_t target) {
+  _cfg.add_edge(_current, target);
+  _current = _cfg.new_block(); // whatever comes next is unreachable
+}
+
+size_t og::control_flow_graph_builder::declare(const std::string &name) {
+  return _scopes.back()[name] = _cfg.new_variable(name);
+}
+
+size_t *og::control_flow_graph_builder::lookup(const std::string &name) {
+  for (auto it = _scopes.rbegin(); it != _scopes.rend(); it++) {
+    auto var = it->find(name);
+    if (var != it->end()) return &var->second;
+  }
+  return nullptr; // global
+}
+
+//---------------------------------------------------------------------------
+
+void og::control_flow_graph_builder::do_function_definition_node(og::function_definition_node * const node, int lvl) {
+  _scopes.emplace_back();
+
+  if (node->arguments()) {
+    for (auto arg : node->arguments()->nodes()) {
+      append(arg, lvl);
+
+      // arguments are defined on entry
+      auto &stmt = _cfg.block(_current).statements.back();
+      for (auto &id : dynamic_cast<og::variable_declaration_node*>(arg)->identifiers()) {
+        stmt.defs.push_back(*lookup(id));
+      }
+    }
+  }
+
+  node->block()->accept(this, lvl + 2);
+  _cfg.add_edge(_current, _cfg.exit());
+
+  _scopes.pop_back();
+}
+
+void og::control_flow_graph_builder::do_block_node(og::block_node * const node, int lvl) {
+  _scopes.emplace_back();
+  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
+  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+  _scopes.pop_back();
+}
+
+void og::control_flow_graph_builder::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  for (auto child : node->nodes()) {
+    child->accept(this, lvl + 2);
+  }
+}
+
+void og::control_flow_graph_builder::do_if_node(og::if_node * const node, int lvl) {
+  append(node->condition(), lvl + 2);
+  size_t cond = _current;
+
+  _current = _cfg.new_block();
+  _cfg.add_edge(cond, _current);
+  node->block()->accept(this, lvl + 2);
+
+  size_t end = _cfg.new_block();
+  _cfg.add_edge(_current, end);
+  _cfg.add_edge(cond, end);
+  _current = end;
+}
+
+void og::control_flow_graph_builder::do_if_else_node(og::if_else_node * const node, int lvl) {
+  append(node->condition(), lvl + 2);
+  size_t cond = _current;
+  size_t end = _cfg.new_block();
+
+  _current = _cfg.new_block();
+  _cfg.add_edge(cond, _current);
+  node->thenblock()->accept(this, lvl + 2);
+  _cfg.add_edge(_current, end);
+
+  _current = _cfg.new_block();
+  _cfg.add_edge(cond, _current);
+  node->elseblock()->accept(this, lvl + 2);
+  _cfg.add_edge(_current, end);
+
+  _current = end;
+}
+
+void og::control_flow_graph_builder::do_for_node(og::for_node * const node, int lvl) {
+  _scopes.emplace_back();
+
+  if (node->initializers()) {
+    node->initializers()->accept(this, lvl);
+  }
+
+  size_t header = _cfg.new_block();
+  _cfg.add_edge(_current, header);
+  _current = header;
+  if (node->condition()) {
+    append(node->condition(), lvl);
+  }
+
+  size_t body = _cfg.new_block();
+  size_t incr = _cfg.new_block();
+  size_t end = _cfg.new_block();
+  _cfg.add_edge(header, body);
+  if (node->condition()) {
+    _cfg.add_edge(header, end); // no condition: only leaves through break/return
+  }
+
+  _continueTargets.push(incr);
+  _breakTargets.push(end);
+
+  _current = body;
+  if (node->block()) {
+    node->block()->accept(this, lvl + 2);
+  }
+  _cfg.add_edge(_current, incr);
+
+  _current = incr;
+  if (node->increments()) {
+    node->increments()->accept(this, lvl);
+  }
+  _cfg.add_edge(_current, header);
+
+  _continueTargets.pop();
+  _breakTargets.pop();
+
+  _current = end;
+  _scopes.pop_back();
+}
+
+void og::control_flow_graph_builder::do_return_node(og::return_node * const node, int lvl) {
+  if (_statement) {
+    if (node->retval()) node->retval()->accept(this, lvl + 2);
+    return;
+  }
+  append(node, lvl);
+  jump(_cfg.exit());
+}
+void og::control_flow_graph_builder::do_continue_node(og::continue_node * const node, int lvl) {
+  if (_statement) return;
+  append(node, lvl);
+  jump(_continueTargets.top());
+}
+void og::control_flow_graph_builder::do_break_node(og::break_node * const node, int lvl) {
+  if (_statement) return;
+  append(node, lvl);
+  jump(_breakTargets.top());
+}
+
+//---------------------------------------------------------------------------
+
+void og::control_flow_graph_builder::do_variable_declaration_node(og::variable_declaration_node * const node, int lvl) {
+  PLACE_STATEMENT;
+
+  if (node->initializer()) {
+    node->initializer()->accept(this, lvl + 2);
+  }
+
+  // declared after the initializer is evaluated: the initializer sees outer variables
+  for (auto &id : node->identifiers()) {
+    size_t var = declare(id);
+    if (node->initializer()) _statement->defs.push_back(var);
+  }
+}
+
+void og::control_flow_graph_builder::do_evaluation_node(og::evaluation_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_write_node(og::write_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+
+void og::control_flow_graph_builder::do_variable_node(cdk::variable_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  if (auto var = lookup(node->name())) _statement->uses.push_back(*var);
+}
+void og::control_flow_graph_builder::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->lvalue()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_assignment_node(cdk::assignment_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->rvalue()->accept(this, lvl + 2);
+
+  auto variable = dynamic_cast<cdk::variable_node*>(node->lvalue());
+  if (variable && lookup(variable->name())) {
+    _statement->defs.push_back(*lookup(variable->name()));
+  } else {
+    node->lvalue()->accept(this, lvl + 2); // pointer/tuple index: only uses
+  }
+}
+void og::control_flow_graph_builder::do_address_of_node(og::address_of_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  auto variable = dynamic_cast<cdk::variable_node*>(node->lvalue());
+  if (variable && lookup(variable->name())) {
+    _cfg.mark_escaping(*lookup(variable->name()));
+  }
+  node->lvalue()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_pointer_index_node(og::pointer_index_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->base()->accept(this, lvl + 2);
+  node->index()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_tuple_index_node(og::tuple_index_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->base()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_tuple_node(og::tuple_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->seq()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_function_call_node(og::function_call_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  if (node->arguments()) node->arguments()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_sizeof_node(og::sizeof_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->arguments()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_stack_alloc_node(og::stack_alloc_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_identity_node(og::identity_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_neg_node(cdk::neg_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+void og::control_flow_graph_builder::do_not_node(cdk::not_node * const node, int lvl) {
+  PLACE_STATEMENT;
+  node->argument()->accept(this, lvl + 2);
+}
+
+//---------------------------------------------------------------------------
+
+#define BINARY_OPERATION(NAME) \
+void og::control_flow_graph_builder::do_##NAME##_node(cdk::NAME##_node * const node, int lvl) { \
+  PLACE_STATEMENT; \
+  node->left()->accept(this, lvl + 2); \
+  node->right()->accept(this, lvl + 2); \
+}
+
+BINARY_OPERATION(add)
+BINARY_OPERATION(sub)
+BINARY_OPERATION(mul)
+BINARY_OPERATION(div)
+BINARY_OPERATION(mod)
+BINARY_OPERATION(lt)
+BINARY_OPERATION(le)
+BINARY_OPERATION(ge)
+BINARY_OPERATION(gt)
+BINARY_OPERATION(ne)
+BINARY_OPERATION(eq)
+BINARY_OPERATION(and)
+BINARY_OPERATION(or)
+
+#undef BINARY_OPERATION
+
+//---------------------------------------------------------------------------
+
+void og::control_flow_graph_builder::do_integer_node(cdk::integer_node * const node, int lvl) {
+  PLACE_STATEMENT;
+}
+void og::control_flow_graph_builder::do_double_node(cdk::double_node * const node, int lvl) {
+  PLACE_STATEMENT;
+}
+void og::control_flow_graph_builder::do_string_node(cdk::string_node * const node, int lvl) {
+  PLACE_STATEMENT;
+}
+void og::control_flow_graph_builder::do_nullptr_node(og::nullptr_node * const node, int lvl) {
+  PLACE_STATEMENT;
+}
+void og::control_flow_graph_builder::do_input_node(og::input_node * const node, int lvl) {
+  PLACE_STATEMENT;
+}
+void og::control_flow_graph_builder::do_nil_node(cdk::nil_node * const node, int lvl) {
+  // EMPTY
+}
+void og::control_flow_graph_builder::do_data_node(cdk::data_node * const node, int lvl) {
+  // EMPTY
+}
+void og::control_flow_graph_builder::do_function_declaration_node(og::function_declaration_node * const node, int lvl) {
+  // EMPTY
+}
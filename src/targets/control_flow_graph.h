@@ -0,0 +1,124 @@
+#ifndef __OG_TARGET_CONTROL_FLOW_GRAPH_H__
+#define __OG_TARGET_CONTROL_FLOW_GRAPH_H__
+
+#include "targets/basic_ast_visitor.h"
+
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+
+namespace og {
+
+  /**
+   * A statement (or loop/if condition) placed in a basic block, along with the
+   * local variables it reads and writes (in evaluation order, uses first).
+   */
+  struct cfg_statement {
+    cdk::basic_node *node;
+    std::vector<size_t> uses;
+    std::vector<size_t> defs;
+  };
+
+  struct basic_block {
+    size_t id;
+    std::vector<cfg_statement> statements;
+    std::vector<size_t> successors;
+    std::vector<size_t> predecessors;
+  };
+
+  /**
+   * Statement-level control flow graph of a function body.
+   * Block 0 is the entry and block 1 the exit. Variables are the function's arguments
+   * and locals, numbered in declaration order (shadowing declarations get new ids).
+   * Globals are not tracked.
+   */
+  class control_flow_graph {
+    std::vector<basic_block> _blocks;
+    std::vector<std::string> _variables;
+    std::set<size_t> _escaping; // variables whose address was taken
+
+  public:
+    control_flow_graph() {
+      new_block(); // entry
+      new_block(); // exit
+    }
+
+  public:
+    size_t entry() const {
+      return 0;
+    }
+    size_t exit() const {
+      return 1;
+    }
+
+    const std::vector<basic_block> &blocks() const {
+      return _blocks;
+    }
+    basic_block &block(size_t id) {
+      return _blocks[id];
+    }
+    const basic_block &block(size_t id) const {
+      return _blocks[id];
+    }
+
+    const std::vector<std::string> &variables() const {
+      return _variables;
+    }
+    bool is_escaping(size_t var) const {
+      return _escaping.count(var) != 0;
+    }
+
+  public:
+    size_t new_block();
+    void add_edge(size_t from, size_t to);
+    size_t new_variable(const std::string &name);
+    void mark_escaping(size_t var) {
+      _escaping.insert(var);
+    }
+
+    std::vector<bool> reachable() const;
+    std::vector<size_t> reverse_postorder() const;
+  };
+
+  /**
+   * Builds the control flow graph of a function definition.
+   * Expressions (including && and ||) are not split across blocks.
+   */
+  class control_flow_graph_builder: public basic_ast_visitor {
+    control_flow_graph &_cfg;
+    size_t _current;
+
+    std::stack<size_t> _continueTargets;
+    std::stack<size_t> _breakTargets;
+
+    std::vector<std::map<std::string, size_t>> _scopes;
+    cfg_statement *_statement = nullptr; // statement collecting uses/defs (nullptr if none)
+
+  public:
+    control_flow_graph_builder(std::shared_ptr<cdk::compiler> compiler, control_flow_graph &cfg) :
+        basic_ast_visitor(compiler), _cfg(cfg), _current(cfg.entry()) {
+    }
+
+  public:
+    ~control_flow_graph_builder() {}
+
+  protected:
+    void append(cdk::basic_node *node, int lvl);
+    void jump(size_t target);
+    size_t declare(const std::string &name);
+    size_t *lookup(const std::string &name);
+
+  public:
+  // do not edit these lines
+#define __IN_VISITOR_HEADER__
+#include "ast/visitor_decls.h"       // automatically generated
+#undef __IN_VISITOR_HEADER__
+  // do not edit these lines: end
+
+  };
+
+} // og
+
+#endif
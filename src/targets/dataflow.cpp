@@ -0,0 +1,84 @@
+#include "targets/dataflow.h"
+
+//---------------------------------------------------------------------------
+//     LIVENESS
+//---------------------------------------------------------------------------
+
+og::dataflow_result og::compute_liveness(const control_flow_graph &cfg) {
+  size_t width = cfg.variables().size();
+
+  return solve_dataflow(cfg, dataflow_direction::BACKWARD, dataflow_meet::UNION, width, dataflow_set(width, false),
+    [&](size_t b, const dataflow_set &liveOut) {
+      auto &statements = cfg.block(b).statements;
+      dataflow_set live = liveOut;
+      for (auto it = statements.rbegin(); it != statements.rend(); it++) {
+        for (size_t var : it->defs) live[var] = false;
+        for (size_t var : it->uses) live[var] = true;
+      }
+      return live;
+    });
+}
+
+std::vector<og::dataflow_set> og::statement_liveness(const basic_block &block, const dataflow_set &liveOut) {
+  std::vector<dataflow_set> liveAfter(block.statements.size());
+  dataflow_set live = liveOut;
+  for (size_t i = block.statements.size(); i-- > 0;) {
+    liveAfter[i] = live;
+    for (size_t var : block.statements[i].defs) live[var] = false;
+    for (size_t var : block.statements[i].uses) live[var] = true;
+  }
+  return liveAfter;
+}
+
+//---------------------------------------------------------------------------
+//     REACHING DEFINITIONS
+//---------------------------------------------------------------------------
+
+og::reaching_definitions og::compute_reaching_definitions(const control_flow_graph &cfg) {
+  reaching_definitions result;
+
+  std::vector<std::vector<size_t>> definitionsOf(cfg.variables().size());
+  for (auto &block : cfg.blocks()) {
+    for (size_t s = 0; s < block.statements.size(); s++) {
+      for (size_t var : block.statements[s].defs) {
+        definitionsOf[var].push_back(result.definitions.size());
+        result.definitions.push_back(definition{block.id, s, var});
+      }
+    }
+  }
+
+  size_t width = result.definitions.size();
+  result.sets = solve_dataflow(cfg, dataflow_direction::FORWARD, dataflow_meet::UNION, width, dataflow_set(width, false),
+    [&](size_t b, const dataflow_set &in) {
+      dataflow_set out = in;
+      size_t d = 0;
+      // definitions are numbered in block/statement order, skip to this block's
+      while (d < width && result.definitions[d].block != b) d++;
+      for (; d < width && result.definitions[d].block == b; d++) {
+        for (size_t other : definitionsOf[result.definitions[d].variable]) out[other] = false;
+        out[d] = true;
+      }
+      return out;
+    });
+
+  return result;
+}
+
+//---------------------------------------------------------------------------
+//     DOMINATORS
+//---------------------------------------------------------------------------
+
+std::vector<og::dataflow_set> og::compute_dominators(const control_flow_graph &cfg) {
+  size_t width = cfg.blocks().size();
+  dataflow_set entry(width, false);
+  entry[cfg.entry()] = true;
+
+  auto result = solve_dataflow(cfg, dataflow_direction::FORWARD, dataflow_meet::INTERSECTION, width, entry,
+    [&](size_t b, const dataflow_set &in) {
+      dataflow_set out = in;
+      out[b] = true;
+      return out;
+    });
+
+  return result.out;
+}
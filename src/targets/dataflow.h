@@ -0,0 +1,102 @@
+#ifndef __OG_TARGET_DATAFLOW_H__
+#define __OG_TARGET_DATAFLOW_H__
+
+#include <vector>
+#include "targets/control_flow_graph.h"
+
+namespace og {
+
+  // one bit per variable/definition/block, depending on the analysis
+  typedef std::vector<bool> dataflow_set;
+
+  enum class dataflow_direction { FORWARD, BACKWARD };
+  enum class dataflow_meet { UNION, INTERSECTION };
+
+  struct dataflow_result {
+    std::vector<dataflow_set> in;
+    std::vector<dataflow_set> out;
+  };
+
+  /**
+   * Iterative bit-vector dataflow solver.
+   * `boundary` is the value at the entry (forward) or exit (backward) block,
+   * every other block starts at the meet's identity (empty for union, full for intersection).
+   * `transfer(block, input)` computes the block's output from its input.
+   */
+  template<typename Transfer>
+  dataflow_result solve_dataflow(const control_flow_graph &cfg, dataflow_direction direction, dataflow_meet meet,
+                                 size_t width, const dataflow_set &boundary, Transfer transfer) {
+    bool forward = direction == dataflow_direction::FORWARD;
+    size_t boundaryBlock = forward ? cfg.entry() : cfg.exit();
+    dataflow_set identity(width, meet == dataflow_meet::INTERSECTION);
+
+    // before: what flows into the block in the analysis direction; after: what flows out
+    std::vector<dataflow_set> before(cfg.blocks().size(), identity), after(cfg.blocks().size(), identity);
+    before[boundaryBlock] = boundary;
+
+    std::vector<size_t> order = cfg.reverse_postorder();
+    if (!forward) order = std::vector<size_t>(order.rbegin(), order.rend());
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (size_t b : order) {
+        auto &block = cfg.block(b);
+        auto &neighbours = forward ? block.predecessors : block.successors;
+
+        if (b != boundaryBlock && !neighbours.empty()) {
+          dataflow_set merged = after[neighbours[0]];
+          for (size_t i = 1; i < neighbours.size(); i++) {
+            for (size_t bit = 0; bit < width; bit++) {
+              if (meet == dataflow_meet::UNION) {
+                merged[bit] = merged[bit] || after[neighbours[i]][bit];
+              } else {
+                merged[bit] = merged[bit] && after[neighbours[i]][bit];
+              }
+            }
+          }
+          before[b] = merged;
+        }
+
+        dataflow_set result = transfer(b, before[b]);
+        if (result != after[b]) {
+          after[b] = result;
+          changed = true;
+        }
+      }
+    }
+
+    if (forward) return dataflow_result{before, after};
+    return dataflow_result{after, before};
+  }
+
+  //---------------------------------------------------------------------------
+  //     ANALYSES
+  //---------------------------------------------------------------------------
+
+  /** Variables live at the start (in) and end (out) of each block. */
+  dataflow_result compute_liveness(const control_flow_graph &cfg);
+
+  /** Variables live right after each statement of a block, given the block's live-out set. */
+  std::vector<dataflow_set> statement_liveness(const basic_block &block, const dataflow_set &liveOut);
+
+  struct definition {
+    size_t block;
+    size_t statement;
+    size_t variable;
+  };
+
+  struct reaching_definitions {
+    std::vector<definition> definitions;
+    dataflow_result sets; // over indexes of definitions
+  };
+
+  /** Definitions that may reach the start (in) and end (out) of each block. */
+  reaching_definitions compute_reaching_definitions(const control_flow_graph &cfg);
+
+  /** For each block, the set of blocks that dominate it (unreachable blocks are dominated by everything). */
+  std::vector<dataflow_set> compute_dominators(const control_flow_graph &cfg);
+
+} // og
+
+#endif
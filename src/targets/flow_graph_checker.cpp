@@ -1,5 +1,7 @@
 #include <iostream>
 #include "targets/flow_graph_checker.h"
+#include "targets/control_flow_graph.h"
+#include "targets/dataflow.h"
 #include "ast/all.h" // automatically generated
 
 // throw without loosing lineno information
@@ -12,6 +14,40 @@ void og::flow_graph_checker::do_function_definition_node(og::function_definition
   if (!_returning && !node->is_typed(cdk::TYPE_VOID)) {
     std::cerr << node->lineno() << ": WARNING: function may not always return" << std::endl;
   }
+
+  control_flow_graph cfg;
+  control_flow_graph_builder builder(_compiler, cfg);
+  node->accept(&builder, lvl);
+  warn_dead_code(cfg);
+}
+
+void og::flow_graph_checker::warn_dead_code(const control_flow_graph &cfg) {
+  auto reachable = cfg.reachable();
+  auto liveness = compute_liveness(cfg);
+
+  for (auto &block : cfg.blocks()) {
+    if (block.statements.empty()) continue;
+
+    if (!reachable[block.id]) {
+      std::cerr << block.statements[0].node->lineno() << ": WARNING: unreachable code" << std::endl;
+      continue;
+    }
+
+    // only report plain "x = ...;" statements, anything else may be there for its side effects
+    auto liveAfter = statement_liveness(block, liveness.out[block.id]);
+    for (size_t i = 0; i < block.statements.size(); i++) {
+      auto evaluation = dynamic_cast<og::evaluation_node*>(block.statements[i].node);
+      if (!evaluation || block.statements[i].defs.size() != 1) continue;
+
+      auto tuple = dynamic_cast<og::tuple_node*>(evaluation->argument());
+      if (!tuple || tuple->size() != 1 || !dynamic_cast<cdk::assignment_node*>(tuple->element(0))) continue;
+
+      size_t var = block.statements[i].defs[0];
+      if (!liveAfter[i][var] && !cfg.is_escaping(var)) {
+        std::cerr << evaluation->lineno() << ": WARNING: value assigned to '" << cfg.variables()[var] << "' is never used" << std::endl;
+      }
+    }
+  }
 }
 void og::flow_graph_checker::do_return_node(og::return_node * const node, int lvl) {
   _returning = true;
@@ -2,6 +2,7 @@
 #define __OG_TARGET_FLOW_GRAPH_CHECKER_H__
 
 #include "targets/basic_ast_visitor.h"
+#include "targets/control_flow_graph.h"
 
 namespace og {
 
@@ -18,6 +19,9 @@ namespace og {
   public:
     ~flow_graph_checker() {}
 
+  protected:
+    void warn_dead_code(const control_flow_graph &cfg);
+
   public:
   // do not edit these lines
 #define __IN_VISITOR_HEADER__
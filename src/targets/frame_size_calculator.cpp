@@ -1,6 +1,9 @@
 #include <string>
+#include <algorithm>
+#include <cstdint>
 #include "targets/frame_size_calculator.h"
 #include "targets/type_checker.h"
+#include "targets/loop_invariant_finder.h"
 #include "targets/symbol.h"
 #include "ast/all.h"
 
@@ -16,7 +19,55 @@ void og::frame_size_calculator::load_value(cdk::typed_node * const lval_or_expr,
   _needTupleAddr = old;
 
   if (lval_or_expr->is_typed(cdk::TYPE_STRUCT) && _evaledTupleAddr) {
-    _unsharedTempSizeTab[caller] = 4; // will need to store a pointer to the top of the tuple
+    temporary(caller, 4); // will need to store a pointer to the top of the tuple
+  }
+}
+
+void og::frame_size_calculator::temporary(cdk::basic_node const * const node, int size) {
+  if (!_unsharedTempSizeTab.count(node)) _temporaries.push_back(node);
+  _unsharedTempSizeTab[node] = size;
+  _tempLifetimes[node] = { _statements.empty() ? 0 : _statements.back(), SIZE_MAX }; // until the statement ends
+}
+
+void og::frame_size_calculator::statement(cdk::basic_node * const node, int lvl) {
+  _statements.push_back(_tick++);
+  node->accept(this, lvl);
+  for (auto &[temp, lifetime] : _tempLifetimes) {
+    if (lifetime.first == _statements.back() && lifetime.second == SIZE_MAX) lifetime.second = _tick;
+  }
+  _tick++;
+  _statements.pop_back();
+}
+
+/**
+ * Give each temporary the lowest slot that does not overlap those of the
+ * temporaries live at the same time (in the order they become live).
+ */
+void og::frame_size_calculator::pack_temporaries() {
+  std::vector<cdk::basic_node const*> order = _temporaries;
+  std::stable_sort(order.begin(), order.end(), [&](cdk::basic_node const *a, cdk::basic_node const *b) {
+    return _tempLifetimes[a].first < _tempLifetimes[b].first;
+  });
+
+  std::vector<cdk::basic_node const*> placed;
+  for (auto temp : order) {
+    auto &lifetime = _tempLifetimes[temp];
+    int size = _unsharedTempSizeTab[temp], slot = 0;
+    for (bool moved = true; moved;) {
+      moved = false;
+      for (auto other : placed) {
+        auto &otherLifetime = _tempLifetimes[other];
+        int otherSlot = _tempSlots[other], otherSize = _unsharedTempSizeTab[other];
+        bool together = lifetime.first <= otherLifetime.second && otherLifetime.first <= lifetime.second;
+        if (together && slot < otherSlot + otherSize && otherSlot < slot + size) {
+          slot = otherSlot + otherSize;
+          moved = true;
+        }
+      }
+    }
+    _tempSlots[temp] = slot;
+    _packedTempSize = std::max(_packedTempSize, (size_t)(slot + size));
+    placed.push_back(temp);
   }
 }
 
@@ -95,8 +146,8 @@ void og::frame_size_calculator::do_or_node(cdk::or_node * const node, int lvl) {
 }
 void og::frame_size_calculator::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
-  if (_needTupleAddr) {
-    node->lvalue()->accept(this, lvl);
+  if (_needTupleAddr || dynamic_cast<cdk::variable_node*>(node->lvalue())) {
+    node->lvalue()->accept(this, lvl); // variables are read in place
   } else {
     load_value(node->lvalue(), lvl, node);
   }
@@ -134,15 +185,31 @@ void og::frame_size_calculator::do_address_of_node(og::address_of_node * const n
 void og::frame_size_calculator::do_function_call_node(og::function_call_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
 
-  if (node->arguments()) {
+  if (node->arguments() && node->arguments()->size() == 1 && node->arguments()->element(0)->is_typed(cdk::TYPE_STRUCT)) {
+    // a tuple spread over the arguments, read through its address (kept in a temporary, unless it is a variable)
+    auto tuple = node->arguments()->element(0);
+    bool old = _needTupleAddr;
+    _needTupleAddr = true;
+    tuple->accept(this, lvl);
+    _needTupleAddr = old;
+    auto rvalue = dynamic_cast<cdk::rvalue_node*>(tuple);
+    if (!rvalue || !dynamic_cast<cdk::variable_node*>(rvalue->lvalue())) {
+      temporary(node, 4);
+    }
+  } else if (node->arguments()) {
     // we don't need space for the whole tuple, just for each argument (possibly)
     for (auto el : node->arguments()->elements()) {
       el->accept(this, lvl);
     }
   }
+  if (node->arguments() && _referenceArguments.count(node->identifier())) {
+    temporary(node->arguments(), _symtab.find(node->identifier())->argsType()->size()); // see postfix_writer::reference_arguments
+  }
 
   if (node->is_typed(cdk::TYPE_STRUCT)) {
-    _calltempsize = std::max(_calltempsize, node->type()->size());
+    // tuples returned in registers are left on the stack, unless their address is needed
+    _evaledTupleAddr = _needTupleAddr || !_registerReturns.count(node->identifier());
+    if (_evaledTupleAddr) _calltempsize = std::max(_calltempsize, node->type()->size());
   }
 }
 void og::frame_size_calculator::do_function_declaration_node(og::function_declaration_node * const node, int lvl) {
@@ -216,7 +283,7 @@ void og::frame_size_calculator::do_tuple_node(og::tuple_node * const node, int l
       sz += 4;
 
     if (sz)
-      _unsharedTempSizeTab[node] = sz;
+      temporary(node, sz);
 
     _evaledTupleAddr = _needTupleAddr;
   } else {
@@ -231,19 +298,53 @@ void og::frame_size_calculator::do_sequence_node(cdk::sequence_node * const node
 }
 
 void og::frame_size_calculator::do_block_node(og::block_node * const node, int lvl) {
-  if (node->declarations()) node->declarations()->accept(this, lvl + 2);
-  if (node->instructions()) node->instructions()->accept(this, lvl + 2);
+  size_t outer = _localsize; // the block's variables are released at its end
+  for (auto sequence : { node->declarations(), node->instructions() }) {
+    if (!sequence) continue;
+    for (auto child : sequence->nodes()) {
+      statement(child, lvl + 2);
+    }
+  }
+  _localsize = outer;
 }
 
 void og::frame_size_calculator::do_for_node(og::for_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
 
+  size_t outer = _localsize; // like blocks, loops have their own scope
   if (node->initializers()) {
     node->initializers()->accept(this, lvl);
   }
 
-  if (node->condition()->is_typed(cdk::TYPE_STRUCT)) {
+  if (node->condition() && node->condition()->is_typed(cdk::TYPE_STRUCT)) {
     load_value(node->condition(), lvl, node);
+  } else {
+    if (node->condition()) node->condition()->accept(this, lvl);
+
+    // invariant expressions get a temporary each, filled before the loop
+    loop_invariant_finder finder(_compiler, _symtab, _pureFunctions, _escaped, _hoisted);
+    for (auto expr : finder.find(node)) {
+      temporary(expr, dynamic_cast<cdk::lvalue_node*>(expr) ? 4 : expr->type()->size());
+      _loopInvariants[node].push_back(expr);
+      _hoisted.insert(expr);
+    }
+
+    // induction pointers (and the final value of the one replacing the condition)
+    auto inductions = finder.inductions(node);
+    for (auto &pointer : inductions.pointers) {
+      temporary(pointer.index, 4);
+    }
+    if (inductions.test >= 0) {
+      temporary(node->condition(), 4);
+    }
+    if (!inductions.pointers.empty()) {
+      _loopInductions[node] = inductions;
+    }
+
+    auto count = finder.counted(node);
+    if (!count.variable.empty()) {
+      _loopCounts[node] = count;
+    }
   }
 
   if (node->block()) {
@@ -253,6 +354,7 @@ void og::frame_size_calculator::do_for_node(og::for_node * const node, int lvl)
   if (node->increments()) {
     node->increments()->accept(this, lvl + 2);
   }
+  _localsize = outer;
 }
 
 void og::frame_size_calculator::do_if_node(og::if_node * const node, int lvl) {
@@ -272,6 +374,7 @@ void og::frame_size_calculator::do_variable_declaration_node(og::variable_declar
   _symtab.pop();
 
   _localsize += node->type()->size();
+  _maxlocalsize = std::max(_maxlocalsize, _localsize);
 
   if (node->initializer()) {
     load_value(node->initializer(), lvl, node);
@@ -286,4 +389,6 @@ void og::frame_size_calculator::do_function_definition_node(og::function_definit
   if (node->is_typed(cdk::TYPE_STRUCT)) {
     _returntempsize = 4; // will need to store a pointer to the top of the tuple
   }
+
+  pack_temporaries();
 }
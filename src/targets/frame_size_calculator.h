@@ -7,8 +7,11 @@
 #include <iostream>
 #include <sstream>
 #include <stack>
+#include <set>
+#include <vector>
 #include <cdk/symbol_table.h>
 #include "targets/symbol.h"
+#include "targets/loop_invariant_finder.h"
 
 namespace og {
 
@@ -18,20 +21,45 @@ namespace og {
     // just so we can call ASSERT_SAFE_EXPRESSIONS
     std::shared_ptr<og::symbol> _function;
 
-    size_t _localsize = 0;
+    size_t _localsize = 0;    // locals in scope
+    size_t _maxlocalsize = 0; // deepest nesting (sibling blocks and loops share their space)
     size_t _calltempsize = 0; // storage for tuple-returning functions (only one is used at a time, so a single space is sufficient)
     size_t _returntempsize = 0; // storage for return with tuple (only one return will run in each function so a single space is sufficient)
 
     std::map<cdk::basic_node const*, int> _unsharedTempSizeTab; // storage required for tuple_nodes temporary variables and for_node temporary variables
 
+    // temporaries are only live in the statement that needs them (loop temporaries, in the whole loop):
+    // those of different statements share their space
+    size_t _tick = 1; // 0: outside any statement (live throughout)
+    std::vector<size_t> _statements; // start of the statements being visited
+    std::vector<cdk::basic_node const*> _temporaries; // in the order they were found
+    std::map<cdk::basic_node const*, std::pair<size_t, size_t>> _tempLifetimes; // [first, last] ticks
+    std::map<cdk::basic_node const*, int> _tempSlots; // displacement from the top of the temporaries
+    size_t _packedTempSize = 0;
+
+    const std::set<std::string> &_pureFunctions;
+    const std::set<std::string> &_registerReturns; // functions that return their tuples in registers (no call temporary)
+    const std::set<std::string> &_referenceArguments; // functions that get a pointer to their arguments
+    std::set<std::string> _escaped; // variables whose address is taken in the function
+    std::set<const cdk::typed_node*> _hoisted; // loop invariants (each has its own temporary)
+    std::map<const og::for_node*, std::vector<cdk::typed_node*>> _loopInvariants;
+    std::map<const og::for_node*, loop_invariant_finder::loop_inductions> _loopInductions;
+    std::map<const og::for_node*, loop_invariant_finder::loop_count> _loopCounts;
+
     bool _needTupleAddr = true; // true = needs tuple to be stored somewhere and evaluate to its base address
     bool _evaledTupleAddr = true; // true = tuple was evaluated to base address
 
     void load_value(cdk::typed_node *lval_or_expr, int lvl, cdk::basic_node const * caller);
+    void temporary(cdk::basic_node const * node, int size);
+    void statement(cdk::basic_node * node, int lvl);
+    void pack_temporaries();
 
   public:
-    frame_size_calculator(std::shared_ptr<cdk::compiler> compiler, std::shared_ptr<og::symbol> function, cdk::symbol_table<og::symbol> &symtab) :
-        basic_ast_visitor(compiler), _symtab(symtab), _function(function) {
+    frame_size_calculator(std::shared_ptr<cdk::compiler> compiler, std::shared_ptr<og::symbol> function, cdk::symbol_table<og::symbol> &symtab,
+                          const std::set<std::string> &pureFunctions, const std::set<std::string> &registerReturns,
+                          const std::set<std::string> &referenceArguments, const std::set<std::string> &escaped) :
+        basic_ast_visitor(compiler), _symtab(symtab), _function(function), _pureFunctions(pureFunctions),
+        _registerReturns(registerReturns), _referenceArguments(referenceArguments), _escaped(escaped) {
     }
 
   public:
@@ -39,13 +67,28 @@ namespace og {
 
   public:
     size_t localsize() const {
-      return _localsize;
+      return _maxlocalsize;
     }
 
     const std::map<cdk::basic_node const*, int> unsharedTempSizeTab() const {
       return _unsharedTempSizeTab;
     }
 
+    /** Expressions to compute before each loop (their temporaries are in unsharedTempSizeTab). */
+    const std::map<const og::for_node*, std::vector<cdk::typed_node*>> &loopInvariants() const {
+      return _loopInvariants;
+    }
+
+    /** Pointers replacing indexing by induction variables (temporaries keyed by the index read and the condition). */
+    const std::map<const og::for_node*, loop_invariant_finder::loop_inductions> &loopInductions() const {
+      return _loopInductions;
+    }
+
+    /** Counted loops (candidates for unrolling). */
+    const std::map<const og::for_node*, loop_invariant_finder::loop_count> &loopCounts() const {
+      return _loopCounts;
+    }
+
     size_t calltempsize() const {
       return _calltempsize;
     }
@@ -54,8 +97,14 @@ namespace og {
       return _returntempsize;
     }
 
-    size_t tempsize() const {
-      size_t totalsz = _calltempsize + _returntempsize;
+    /** Where each temporary starts, below the top of their area (temporaries that are never live together overlap). */
+    const std::map<cdk::basic_node const*, int> &tempSlots() const {
+      return _tempSlots;
+    }
+
+    /** Size of the temporaries if each had its own space. */
+    size_t unpackedTempSize() const {
+      size_t totalsz = 0;
       for (const auto&  tempsz : _unsharedTempSizeTab) {
         totalsz += tempsz.second;
       }
@@ -63,6 +112,10 @@ namespace og {
       return totalsz;
     }
 
+    size_t tempsize() const {
+      return _calltempsize + _returntempsize + _packedTempSize;
+    }
+
   public:
   // do not edit these lines
 #define __IN_VISITOR_HEADER__
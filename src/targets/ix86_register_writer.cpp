@@ -0,0 +1,459 @@
+#include <iostream>
+#include "targets/ix86_register_writer.h"
+#include "targets/constant_division.h"
+#include "targets/tac_builder.h"
+#include "targets/tac_optimizer.h"
+
+//---------------------------------------------------------------------------
+//     PROGRAM
+//---------------------------------------------------------------------------
+
+void og::ix86_register_writer::write(const postfix_buffer &buffer) {
+  auto &code = buffer.code();
+  std::vector<postfix_instruction> function; // text of the current function (data is written right away)
+  bool text = false;
+
+  for (size_t ix = 0; ix < code.size(); ix++) {
+    auto &instruction = code[ix];
+    switch (instruction.op) {
+      case postfix_opcode::TEXT:
+        text = true;
+        if (postfix_buffer::starts_function(code, ix)) {
+          if (!function.empty()) write_function(function);
+          function.clear();
+          function.push_back(instruction);
+        } else if (function.empty()) {
+          _pf.emit(instruction);
+        }
+        continue;
+      case postfix_opcode::DATA:
+      case postfix_opcode::RODATA:
+      case postfix_opcode::BSS:
+        text = false;
+        break;
+      case postfix_opcode::EXTERN:
+        _pf.emit(instruction);
+        continue;
+      default:
+        break;
+    }
+
+    if (text && !function.empty()) {
+      function.push_back(instruction);
+    } else {
+      _pf.emit(instruction);
+    }
+  }
+
+  if (!function.empty()) write_function(function);
+}
+
+void og::ix86_register_writer::write_function(const std::vector<postfix_instruction> &function) {
+  size_t enter = 0;
+  while (function[enter].op != postfix_opcode::ENTER) enter++;
+
+  tac_function tac;
+  tac.framesize = function[enter].ival;
+  tac_builder builder(tac);
+  if (!builder.build(std::vector<postfix_instruction>(function.begin() + enter + 1, function.end()))) {
+    if (_compiler->debug()) {
+      std::cerr << "asm-reg: " << function[enter - 1].sval << " left to the postfix emitter (" << builder.error() << ")"
+          << std::endl;
+    }
+    for (auto &instruction : function) {
+      _pf.emit(instruction);
+    }
+    return;
+  }
+
+  tac_optimizer optimizer(tac);
+  optimizer.run();
+  linear_scan_allocator allocator(tac);
+  allocator.run();
+
+  // TEXT ALIGN [GLOBAL] LABEL
+  for (size_t ix = 0; ix < enter; ix++) {
+    _pf.emit(function[ix]);
+  }
+
+  _function = &tac;
+  _allocator = &allocator;
+  _frameless = frameless();
+  write_prologue();
+  for (auto &instruction : tac.code) {
+    write_instruction(instruction);
+  }
+  _function = nullptr;
+  _allocator = nullptr;
+  _frameless = false;
+}
+
+//---------------------------------------------------------------------------
+//     OPERANDS
+//---------------------------------------------------------------------------
+
+std::string og::ix86_register_writer::frame(int offset) const {
+  if (_frameless) {
+    // no saved ebp: the return address is at [esp+4*saved]
+    return "[esp+" + std::to_string(offset - 4 + 4 * _allocator->saved().size()) + "]";
+  }
+  if (offset < 0) return "[ebp-" + std::to_string(-offset) + "]";
+  return "[ebp+" + std::to_string(offset) + "]";
+}
+
+static std::string displaced(const std::string &base, int offset) {
+  if (offset == 0) return base;
+  if (offset < 0) return base + "-" + std::to_string(-offset);
+  return base + "+" + std::to_string(offset);
+}
+
+static const char *suffix(og::tac_condition cond) {
+  switch (cond) {
+    case og::tac_condition::EQ: return "e";
+    case og::tac_condition::NE: return "ne";
+    case og::tac_condition::LT: return "l";
+    case og::tac_condition::LE: return "le";
+    case og::tac_condition::GT: return "g";
+    case og::tac_condition::GE: return "ge";
+  }
+  return "";
+}
+
+bool og::ix86_register_writer::in_register(int vreg) const {
+  return !_allocator->location(vreg).reg.empty();
+}
+
+std::string og::ix86_register_writer::location(int vreg) const {
+  auto &location = _allocator->location(vreg);
+  if (!location.reg.empty()) return location.reg;
+  return "dword " + frame(location.offset);
+}
+
+std::string og::ix86_register_writer::value(const tac_operand &operand) const {
+  if (operand.is_vreg()) return location(operand.vreg);
+  if (operand.label.empty()) return std::to_string(operand.imm);
+  return displaced(operand.label, operand.imm);
+}
+
+bool og::ix86_register_writer::in_memory(const tac_operand &operand) const {
+  return operand.is_vreg() && !in_register(operand.vreg);
+}
+
+//---------------------------------------------------------------------------
+//     INSTRUCTIONS
+//---------------------------------------------------------------------------
+
+/**
+ * Whether the function can do without a frame: it calls nothing (so esp
+ * stays put), and only its arguments are left in memory.
+ */
+bool og::ix86_register_writer::frameless() const {
+  if (_allocator->spillsize()) return false;
+  for (auto &instruction : _function->code) {
+    switch (instruction.op) {
+      case tac_opcode::CALL: case tac_opcode::PUSH: case tac_opcode::POP: case tac_opcode::ADJSP:
+        return false;
+      case tac_opcode::LOADF: case tac_opcode::STOREF: case tac_opcode::FRAME:
+        if (instruction.imm < 0) return false;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+void og::ix86_register_writer::write_prologue() {
+  auto &saved = _allocator->saved();
+  if (_frameless) {
+    for (auto &reg : saved) o("push", reg);
+    return;
+  }
+
+  int size = _function->framesize + _allocator->spillsize() + 4 * saved.size();
+
+  o("push", "ebp");
+  o("mov", "ebp, esp");
+  if (size) o("sub", "esp, " + std::to_string(size));
+  for (size_t ix = 0; ix < saved.size(); ix++) {
+    o("mov", frame(-(_function->framesize + _allocator->spillsize() + 4 * (ix + 1))) + ", " + saved[ix]);
+  }
+}
+
+void og::ix86_register_writer::write_epilogue(const std::string &tailTarget) {
+  auto &saved = _allocator->saved();
+  if (_frameless) {
+    for (size_t ix = saved.size(); ix-- > 0;) o("pop", saved[ix]);
+  } else {
+    for (size_t ix = 0; ix < saved.size(); ix++) {
+      o("mov", saved[ix] + ", " + frame(-(_function->framesize + _allocator->spillsize() + 4 * (ix + 1))));
+    }
+    o("leave");
+  }
+  if (tailTarget.empty()) {
+    o("ret");
+  } else {
+    o("jmp", tailTarget);
+  }
+}
+
+void og::ix86_register_writer::assign(int dst, const std::string &source, bool sourceInMemory) {
+  std::string target = location(dst);
+  if (target == source) return;
+  if (sourceInMemory && !in_register(dst)) {
+    o("mov", "eax, " + source);
+    o("mov", target + ", eax");
+  } else {
+    o("mov", target + ", " + source);
+  }
+}
+
+void og::ix86_register_writer::compare(int a, const tac_operand &b) {
+  if (!in_register(a) && in_memory(b)) {
+    o("mov", "eax, " + location(a));
+    o("cmp", "eax, " + value(b));
+  } else {
+    o("cmp", location(a) + ", " + value(b));
+  }
+}
+
+void og::ix86_register_writer::binary(const tac_instruction &instruction) {
+  const char *mnemonic = "";
+  switch (instruction.op) {
+    case tac_opcode::ADD: mnemonic = "add"; break;
+    case tac_opcode::SUB: mnemonic = "sub"; break;
+    case tac_opcode::MUL: mnemonic = "imul"; break;
+    case tac_opcode::AND: mnemonic = "and"; break;
+    case tac_opcode::OR: mnemonic = "or"; break;
+    case tac_opcode::XOR: mnemonic = "xor"; break;
+    case tac_opcode::SHL: mnemonic = "shl"; break;
+    case tac_opcode::SHR: mnemonic = "shr"; break;
+    case tac_opcode::SAR: mnemonic = "sar"; break;
+    default: break;
+  }
+  bool commutative = instruction.op == tac_opcode::ADD || instruction.op == tac_opcode::MUL
+      || instruction.op == tac_opcode::AND || instruction.op == tac_opcode::OR || instruction.op == tac_opcode::XOR;
+
+  // operate in place when the result lives in a register
+  std::string target = "eax";
+  std::string a = location(instruction.a);
+  std::string b = value(instruction.b);
+  if (in_register(instruction.dst)) {
+    std::string dst = location(instruction.dst);
+    if (b != dst) {
+      target = dst;
+    } else if (commutative) {
+      target = dst;
+      std::swap(a, b);
+    }
+  }
+
+  if (target != a) o("mov", target + ", " + a);
+  if (instruction.op == tac_opcode::MUL && !instruction.b.is_vreg()) {
+    o("imul", target + ", " + target + ", " + b);
+  } else {
+    o(mnemonic, target + ", " + b);
+  }
+  if (target == "eax") assign(instruction.dst, "eax", false);
+}
+
+void og::ix86_register_writer::division(const tac_instruction &instruction) {
+  int divisor = instruction.b.imm;
+  if (!instruction.b.is_vreg() && instruction.b.label.empty() && (divisor >= 2 || divisor <= -2)) {
+    // a multiplication (see constant_division.h): the dividend is not in eax or edx (they are scratch)
+    division_magic magic(divisor);
+    std::string n = location(instruction.a);
+    o("mov", "eax, " + std::to_string(magic.multiplier));
+    o("imul", n);
+    if (magic.correction(divisor) > 0) o("add", "edx, " + n);
+    if (magic.correction(divisor) < 0) o("sub", "edx, " + n);
+    if (magic.shift) o("sar", "edx, " + std::to_string(magic.shift));
+    o("mov", "eax, edx");
+    o("shr", "eax, 31");
+    o("add", "eax, edx");
+    if (instruction.op == tac_opcode::MOD) {
+      o("imul", "eax, eax, " + std::to_string(divisor));
+      o("mov", "edx, " + n);
+      o("sub", "edx, eax");
+    }
+    assign(instruction.dst, instruction.op == tac_opcode::DIV ? "eax" : "edx", false);
+    return;
+  }
+
+  o("mov", "eax, " + location(instruction.a));
+  o("cdq");
+  if (instruction.b.is_vreg()) {
+    o("idiv", location(instruction.b.vreg));
+  } else {
+    o("push", "dword " + value(instruction.b));
+    o("idiv", "dword [esp]");
+    o("add", "esp, 4");
+  }
+  assign(instruction.dst, instruction.op == tac_opcode::DIV ? "eax" : "edx", false);
+}
+
+void og::ix86_register_writer::store(const std::string &address, const tac_operand &operand) {
+  if (in_memory(operand)) {
+    o("mov", "edx, " + value(operand));
+    o("mov", "dword " + address + ", edx");
+  } else {
+    o("mov", "dword " + address + ", " + value(operand));
+  }
+}
+
+void og::ix86_register_writer::write_instruction(const tac_instruction &instruction) {
+  std::string base;
+
+  switch (instruction.op) {
+    case tac_opcode::MOV:
+      assign(instruction.dst, location(instruction.a), !in_register(instruction.a));
+      break;
+    case tac_opcode::MOVI:
+      if (instruction.imm == 0 && in_register(instruction.dst)) {
+        o("xor", location(instruction.dst) + ", " + location(instruction.dst));
+      } else {
+        o("mov", location(instruction.dst) + ", " + std::to_string(instruction.imm));
+      }
+      break;
+    case tac_opcode::ADDRESS:
+      o("mov", location(instruction.dst) + ", " + displaced(instruction.label, instruction.imm));
+      break;
+    case tac_opcode::FRAME:
+      if (in_register(instruction.dst)) {
+        o("lea", location(instruction.dst) + ", " + frame(instruction.imm));
+      } else {
+        o("lea", "eax, " + frame(instruction.imm));
+        assign(instruction.dst, "eax", false);
+      }
+      break;
+
+    case tac_opcode::LOAD:
+      base = in_register(instruction.a) ? location(instruction.a) : "eax";
+      if (base == "eax") o("mov", "eax, " + location(instruction.a));
+      assign(instruction.dst, "dword [" + displaced(base, instruction.imm) + "]", true);
+      break;
+    case tac_opcode::LOADF:
+      assign(instruction.dst, "dword " + frame(instruction.imm), true);
+      break;
+    case tac_opcode::LOADG:
+      assign(instruction.dst, "dword [" + displaced(instruction.label, instruction.imm) + "]", true);
+      break;
+
+    case tac_opcode::STORE:
+      base = in_register(instruction.a) ? location(instruction.a) : "eax";
+      if (base == "eax") o("mov", "eax, " + location(instruction.a));
+      store("[" + displaced(base, instruction.imm) + "]", instruction.b);
+      break;
+    case tac_opcode::STOREF:
+      store(frame(instruction.imm), instruction.b);
+      break;
+    case tac_opcode::STOREG:
+      store("[" + displaced(instruction.label, instruction.imm) + "]", instruction.b);
+      break;
+
+    case tac_opcode::ADD:
+    case tac_opcode::SUB:
+    case tac_opcode::MUL:
+    case tac_opcode::AND:
+    case tac_opcode::OR:
+    case tac_opcode::XOR:
+    case tac_opcode::SHL:
+    case tac_opcode::SHR:
+    case tac_opcode::SAR:
+      binary(instruction);
+      break;
+    case tac_opcode::DIV:
+    case tac_opcode::MOD:
+      division(instruction);
+      break;
+
+    case tac_opcode::NEG:
+      if (in_register(instruction.dst)) {
+        assign(instruction.dst, location(instruction.a), !in_register(instruction.a));
+        o("neg", location(instruction.dst));
+      } else {
+        o("mov", "eax, " + location(instruction.a));
+        o("neg", "eax");
+        assign(instruction.dst, "eax", false);
+      }
+      break;
+    case tac_opcode::NOT:
+      compare(instruction.a, tac_immediate(0));
+      o("sete", "al");
+      o("movzx", "eax, al");
+      assign(instruction.dst, "eax", false);
+      break;
+    case tac_opcode::SET:
+      compare(instruction.a, instruction.b);
+      o(std::string("set") + suffix(instruction.cond), "al");
+      o("movzx", "eax, al");
+      assign(instruction.dst, "eax", false);
+      break;
+
+    case tac_opcode::JMP:
+      o("jmp", "near " + instruction.label);
+      break;
+    case tac_opcode::JCC:
+      compare(instruction.a, instruction.b);
+      o(std::string("j") + suffix(instruction.cond), "near " + instruction.label);
+      break;
+    case tac_opcode::JTABLE: {
+      std::string index = location(instruction.a);
+      if (!in_register(instruction.a)) {
+        o("mov", "eax, " + index);
+        index = "eax";
+      }
+      o("cmp", index + ", " + std::to_string(instruction.targets.size()));
+      o("jae", "near " + instruction.label);
+      o("jmp", "dword [" + instruction.b.label + "+" + index + "*4]");
+      _pf.emit({postfix_opcode::RODATA});
+      _pf.emit({postfix_opcode::ALIGN});
+      _pf.emit({postfix_opcode::LABEL, 0, 0, instruction.b.label});
+      for (auto &target : instruction.targets) {
+        _pf.emit({postfix_opcode::SADDR, 0, 0, target});
+      }
+      _pf.emit({postfix_opcode::TEXT});
+      break;
+    }
+    case tac_opcode::LABEL:
+      _os << instruction.label << ":" << std::endl;
+      break;
+
+    case tac_opcode::PUSH:
+      if (instruction.b.is_vreg() && in_register(instruction.b.vreg)) {
+        o("push", value(instruction.b));
+      } else if (instruction.b.is_vreg()) {
+        o("push", location(instruction.b.vreg));
+      } else {
+        o("push", "dword " + value(instruction.b));
+      }
+      break;
+    case tac_opcode::POP:
+      o("pop", location(instruction.dst));
+      break;
+    case tac_opcode::ADJSP:
+      o("add", "esp, " + std::to_string(instruction.imm));
+      break;
+    case tac_opcode::ARG:
+      o("mov", std::string(instruction.imm ? "edx" : "ecx") + ", " + value(instruction.b));
+      break;
+    case tac_opcode::CALL:
+      o("call", instruction.label);
+      break;
+    case tac_opcode::RESULT:
+      assign(instruction.dst, instruction.imm ? "edx" : "eax", false);
+      break;
+    case tac_opcode::PARAM:
+      assign(instruction.dst, instruction.imm ? "edx" : "ecx", false);
+      break;
+    case tac_opcode::RETVAL:
+      o("mov", std::string(instruction.imm ? "edx" : "eax") + ", " + value(instruction.b));
+      break;
+    case tac_opcode::EPILOGUE:
+      write_epilogue();
+      break;
+    case tac_opcode::TAILJMP:
+      write_epilogue(instruction.label);
+      break;
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef __OG_TARGETS_IX86_REGISTER_WRITER_H__
+#define __OG_TARGETS_IX86_REGISTER_WRITER_H__
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cdk/compiler.h>
+#include <cdk/emitters/basic_postfix_emitter.h>
+#include "targets/postfix_buffer.h"
+#include "targets/postfix_tos_emitter.h"
+#include "targets/tac.h"
+#include "targets/linear_scan_allocator.h"
+
+namespace og {
+
+  /**
+   * Writes ix86 assembly for a postfix program, keeping values in registers.
+   * Each function body is translated to three-address code, optimized and
+   * register-allocated, then written directly. Functions that use operations
+   * the translation does not handle (doubles, tuple copies, ...) and all data
+   * are passed on to the postfix emitter (through the TOS cache).
+   *
+   * Leaf functions that keep everything in registers do not set up a frame:
+   * their arguments are addressed off esp, past the callee-saved registers
+   * they push.
+   */
+  class ix86_register_writer {
+    std::shared_ptr<cdk::compiler> _compiler;
+    std::ostream &_os;
+    postfix_tos_emitter _pf; // everything not written by this class
+
+    // function being written
+    const tac_function *_function = nullptr;
+    const linear_scan_allocator *_allocator = nullptr;
+    bool _frameless = false;
+
+  public:
+    ix86_register_writer(std::shared_ptr<cdk::compiler> compiler, cdk::basic_postfix_emitter &pf) :
+        _compiler(compiler), _os(*compiler->ostream()), _pf(pf, _os) {
+    }
+
+  public:
+    void write(const postfix_buffer &buffer);
+
+  private:
+    void write_function(const std::vector<postfix_instruction> &function);
+
+    bool frameless() const;
+    void write_prologue();
+    void write_epilogue(const std::string &tailTarget = "");
+    void write_instruction(const tac_instruction &instruction);
+
+    // assembly output
+    void o(const std::string &mnemonic, const std::string &operands = "") {
+      _os << "\t" << mnemonic << "\t" << operands << std::endl;
+    }
+
+    std::string frame(int offset) const;
+    bool in_register(int vreg) const;
+    std::string location(int vreg) const;
+    std::string value(const tac_operand &operand) const;
+    bool in_memory(const tac_operand &operand) const;
+
+    void assign(int dst, const std::string &source, bool sourceInMemory);
+    void compare(int a, const tac_operand &b);
+    void binary(const tac_instruction &instruction);
+    void division(const tac_instruction &instruction);
+    void store(const std::string &address, const tac_operand &value);
+  };
+
+} // og
+
+#endif
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <climits>
+#include <map>
+#include "targets/linear_scan_allocator.h"
+#include "targets/dataflow.h"
+
+static bool ends_block(og::tac_opcode op) {
+  return op == og::tac_opcode::JMP || op == og::tac_opcode::JCC || op == og::tac_opcode::JTABLE
+      || op == og::tac_opcode::EPILOGUE || op == og::tac_opcode::TAILJMP;
+}
+
+std::vector<og::linear_scan_allocator::interval> og::linear_scan_allocator::compute_intervals() {
+  auto &code = _function.code;
+
+  // one statement per instruction, no AST node
+  control_flow_graph cfg;
+  for (int vreg = 0; vreg < _function.vregs; vreg++) {
+    cfg.new_variable("%" + std::to_string(vreg));
+  }
+
+  std::vector<size_t> first; // index of the first instruction of each block (by block id)
+  std::map<std::string, size_t> labels;
+  size_t current = cfg.exit();
+  for (size_t ix = 0; ix < code.size(); ix++) {
+    auto &instruction = code[ix];
+    bool leader = ix == 0 || instruction.op == tac_opcode::LABEL || ends_block(code[ix - 1].op);
+    if (leader) {
+      current = cfg.new_block();
+      first.resize(current + 1);
+      first[current] = ix;
+    }
+    if (instruction.op == tac_opcode::LABEL) labels[instruction.label] = current;
+
+    cfg_statement statement{nullptr, {}, {}};
+    for (int vreg : instruction.uses()) statement.uses.push_back(vreg);
+    if (instruction.dst >= 0) statement.defs.push_back(instruction.dst);
+    cfg.block(current).statements.push_back(statement);
+  }
+  if (code.empty()) return {};
+
+  cfg.add_edge(cfg.entry(), cfg.exit() + 1);
+  for (size_t b = cfg.exit() + 1; b < cfg.blocks().size(); b++) {
+    auto &last = code[first[b] + cfg.block(b).statements.size() - 1];
+    if (last.op == tac_opcode::JMP || last.op == tac_opcode::JCC || last.op == tac_opcode::JTABLE) {
+      cfg.add_edge(b, labels[last.label]);
+    }
+    for (auto &target : last.targets) {
+      cfg.add_edge(b, labels[target]);
+    }
+    if (last.op == tac_opcode::EPILOGUE || last.op == tac_opcode::TAILJMP) {
+      cfg.add_edge(b, cfg.exit());
+    } else if (last.op != tac_opcode::JMP && last.op != tac_opcode::JTABLE && b + 1 < cfg.blocks().size()) {
+      cfg.add_edge(b, b + 1);
+    }
+  }
+
+  std::vector<interval> intervals(_function.vregs);
+  for (int vreg = 0; vreg < _function.vregs; vreg++) {
+    intervals[vreg] = interval{vreg, INT_MAX, -1, false, 0};
+  }
+
+  // backward jumps delimit loops (the code is laid out in source order)
+  std::vector<double> frequency(code.size(), 1);
+  for (size_t ix = 0; ix < code.size(); ix++) {
+    if (code[ix].op != tac_opcode::JMP && code[ix].op != tac_opcode::JCC) continue;
+    size_t target = first[labels[code[ix].label]];
+    for (size_t jx = target; target < ix && jx <= ix; jx++) frequency[jx] *= 10;
+  }
+
+  auto extend = [&](size_t vreg, int position) {
+    intervals[vreg].start = std::min(intervals[vreg].start, position);
+    intervals[vreg].end = std::max(intervals[vreg].end, position);
+  };
+
+  auto liveness = compute_liveness(cfg);
+  for (size_t b = cfg.exit() + 1; b < cfg.blocks().size(); b++) {
+    auto &block = cfg.block(b);
+    auto liveAfter = statement_liveness(block, liveness.out[b]);
+    int start = first[b];
+    for (size_t vreg = 0; vreg < intervals.size(); vreg++) {
+      if (liveness.in[b][vreg]) extend(vreg, start);
+    }
+    for (size_t s = 0; s < block.statements.size(); s++) {
+      int position = start + s;
+      for (size_t vreg : block.statements[s].uses) {
+        extend(vreg, position);
+        intervals[vreg].weight += frequency[position];
+      }
+      for (size_t vreg : block.statements[s].defs) {
+        extend(vreg, position);
+        intervals[vreg].weight += frequency[position];
+      }
+      for (size_t vreg = 0; vreg < intervals.size(); vreg++) {
+        if (!liveAfter[s][vreg]) continue;
+        extend(vreg, position);
+        if (code[position].op == tac_opcode::CALL) intervals[vreg].crossesCall = true;
+      }
+    }
+  }
+
+  std::vector<interval> result;
+  for (auto &i : intervals) {
+    if (i.end < 0) continue;
+    i.weight /= i.end - i.start + 1; // spilling a long interval frees its register for longer
+    result.push_back(i);
+  }
+  std::sort(result.begin(), result.end(), [](const interval &a, const interval &b) {
+    return a.start < b.start;
+  });
+  return result;
+}
+
+void og::linear_scan_allocator::run() {
+  // ecx is clobbered by calls; ebx is not preserved by all of the postfix emitter's code
+  static const std::vector<std::string> anywhere = { "ecx", "ebx", "esi", "edi" };
+  static const std::vector<std::string> acrossCalls = { "esi", "edi" };
+
+  _locations.assign(_function.vregs, vreg_location());
+  std::vector<interval> active;
+  std::map<std::string, bool> used;
+
+  auto spill = [&](int vreg) {
+    _spillsize += 4;
+    _locations[vreg].reg = "";
+    _locations[vreg].offset = -(_function.framesize + _spillsize);
+  };
+
+  for (auto &current : compute_intervals()) {
+    // expire intervals that ended before this one starts
+    for (auto it = active.begin(); it != active.end();) {
+      if (it->end < current.start) {
+        it = active.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    auto &candidates = current.crossesCall ? acrossCalls : anywhere;
+    std::string chosen;
+    for (auto &reg : candidates) {
+      bool busy = false;
+      for (auto &other : active) {
+        busy = busy || _locations[other.vreg].reg == reg;
+      }
+      if (!busy) {
+        chosen = reg;
+        break;
+      }
+    }
+
+    if (chosen.empty()) {
+      // spill whichever interval (this one or an active one) is used least
+      auto victim = active.end();
+      for (auto it = active.begin(); it != active.end(); ++it) {
+        auto &reg = _locations[it->vreg].reg;
+        if (std::find(candidates.begin(), candidates.end(), reg) == candidates.end()) continue;
+        if (victim == active.end() || it->weight < victim->weight
+            || (it->weight == victim->weight && it->end > victim->end)) victim = it;
+      }
+      if (victim == active.end() || current.weight < victim->weight
+          || (current.weight == victim->weight && current.end >= victim->end)) {
+        spill(current.vreg);
+        continue;
+      }
+      chosen = _locations[victim->vreg].reg;
+      spill(victim->vreg);
+      active.erase(victim);
+    }
+
+    _locations[current.vreg].reg = chosen;
+    used[chosen] = true;
+    active.push_back(current);
+  }
+
+  for (auto &reg : { "ebx", "esi", "edi" }) {
+    if (used[reg]) _saved.push_back(reg);
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef __OG_TARGETS_LINEAR_SCAN_ALLOCATOR_H__
+#define __OG_TARGETS_LINEAR_SCAN_ALLOCATOR_H__
+
+#include <string>
+#include <vector>
+#include "targets/tac.h"
+
+namespace og {
+
+  /** Where a virtual register lives: a machine register or a frame slot. */
+  struct vreg_location {
+    std::string reg; // empty: spilled
+    int offset = 0;  // frame offset of the spill slot
+  };
+
+  /**
+   * Linear scan register allocation over the live intervals of a function's
+   * virtual registers (liveness is computed on the TAC's control flow graph).
+   * eax and edx are left free as scratch registers for the code generator.
+   * Values live across calls only get callee-saved registers. When registers
+   * run out, the interval with the fewest (loop-weighted) uses for its length
+   * is spilled.
+   */
+  class linear_scan_allocator {
+    struct interval {
+      int vreg;
+      int start, end;
+      bool crossesCall;
+      double weight; // uses and definitions, weighted by loop depth, per instruction covered
+    };
+
+    tac_function &_function;
+    std::vector<vreg_location> _locations;
+    std::vector<std::string> _saved; // callee-saved registers in use
+    int _spillsize = 0;
+
+  public:
+    linear_scan_allocator(tac_function &function) :
+        _function(function) {
+    }
+
+  public:
+    void run();
+
+    const vreg_location &location(int vreg) const {
+      return _locations[vreg];
+    }
+
+    /** Callee-saved registers written by the function (must be preserved). */
+    const std::vector<std::string> &saved() const {
+      return _saved;
+    }
+
+    /** Bytes of frame used for spill slots, below the postfix frame. */
+    int spillsize() const {
+      return _spillsize;
+    }
+
+  private:
+    std::vector<interval> compute_intervals();
+  };
+
+} // og
+
+#endif
@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include "targets/loop_invariant_finder.h"
+#include "ast/all.h"
+
+void og::loop_invariant_finder::scan(og::function_definition_node *const function) {
+  function->block()->accept(this, 0);
+}
+
+std::vector<cdk::typed_node*> og::loop_invariant_finder::find(og::for_node *const loop) {
+  // the first pass only collects the loop's effects: invariance depends on all of them
+  for (int pass = 0; pass < 2; pass++) {
+    _candidates.clear();
+    _reads.clear();
+    _writes.clear();
+    _indexing.clear();
+
+    // the condition was evaluated once on entry, before the hoisted code runs
+    _guaranteed = true;
+    _barrier = false;
+    if (loop->condition()) loop->condition()->accept(this, 0);
+
+    _guaranteed = true;
+    _barrier = false;
+    if (loop->block()) loop->block()->accept(this, 0);
+
+    _guaranteed = false;
+    _inIncrements = true;
+    if (loop->increments()) loop->increments()->accept(this, 0);
+    _inIncrements = false;
+  }
+  return _candidates;
+}
+
+static bool declares(cdk::basic_node *const initializers, const std::string &name) {
+  if (auto sequence = dynamic_cast<cdk::sequence_node*>(initializers)) {
+    for (auto node : sequence->nodes()) {
+      if (declares(node, name)) return true;
+    }
+  } else if (auto declaration = dynamic_cast<og::variable_declaration_node*>(initializers)) {
+    for (auto &identifier : declaration->identifiers()) {
+      if (identifier == name) return true;
+    }
+  }
+  return false;
+}
+
+static og::tuple_node *increments_of(og::for_node *const loop) {
+  auto evaluation = dynamic_cast<og::evaluation_node*>(loop->increments());
+  return evaluation ? dynamic_cast<og::tuple_node*>(evaluation->argument()) : nullptr;
+}
+
+static cdk::binary_operation_node *comparison_of(og::for_node *const loop) {
+  auto condition = loop->condition();
+  auto tuple = dynamic_cast<og::tuple_node*>(condition);
+  if (tuple && tuple->size() == 1) condition = tuple->element(0);
+  return dynamic_cast<cdk::binary_operation_node*>(condition);
+}
+
+/** Basic induction variables: "i = i + k" in the increments, and no other writes. */
+std::map<std::string, int> og::loop_invariant_finder::induction_steps(og::for_node *const loop) {
+  std::map<std::string, int> steps;
+  auto increments = increments_of(loop);
+  if (!increments) return steps;
+
+  for (auto element : increments->elements()) {
+    auto assignment = dynamic_cast<cdk::assignment_node*>(element);
+    auto variable = assignment ? dynamic_cast<cdk::variable_node*>(assignment->lvalue()) : nullptr;
+    if (!variable || !assignment->is_typed(cdk::TYPE_INT)) continue;
+
+    const std::string &name = variable->name();
+    int step;
+    auto read = linear(assignment->rvalue(), step);
+    if (!read || static_cast<cdk::variable_node*>(read->lvalue())->name() != name) continue;
+    if (_writes[name] != 1 || _escaped.count(name) || may_be_global(name)) continue;
+    steps[name] = step;
+  }
+  return steps;
+}
+
+og::loop_invariant_finder::loop_inductions og::loop_invariant_finder::inductions(og::for_node *const loop) {
+  loop_inductions result;
+  auto increments = increments_of(loop);
+  if (!increments) return result;
+  auto steps = induction_steps(loop);
+
+  // invariant pointers indexed by them
+  std::map<std::string, int> uses; // induction variable -> reduced accesses
+  for (auto access : _indexing) {
+    int offset;
+    auto index = linear(access->index(), offset);
+    auto base = dynamic_cast<cdk::rvalue_node*>(access->base());
+    auto pointer = base ? dynamic_cast<cdk::variable_node*>(base->lvalue()) : nullptr;
+    if (!index || !pointer || !invariant_variable(pointer->name())) continue;
+
+    auto &name = static_cast<cdk::variable_node*>(index->lvalue())->name();
+    auto step = steps.find(name);
+    int size = cdk::reference_type_cast(base->type())->referenced()->size();
+    if (step == steps.end() || size == 0) continue;
+
+    induction_pointer *group = nullptr;
+    for (auto &candidate : result.pointers) {
+      auto other = static_cast<cdk::variable_node*>(candidate.base->lvalue());
+      auto variable = static_cast<cdk::variable_node*>(candidate.index->lvalue());
+      if (other->name() == pointer->name() && variable->name() == name) group = &candidate;
+    }
+    if (!group) {
+      result.pointers.push_back({ index, base, step->second * size, {} });
+      group = &result.pointers.back();
+    }
+    group->accesses.push_back({ access, offset * size });
+    uses[name]++;
+  }
+
+  // "i < bound" (or "i != bound") can test the pointer instead, and then i may be dead
+  auto comparison = comparison_of(loop);
+  if (!comparison || increments->size() != 1) return result;
+
+  int offset;
+  auto read = linear(comparison->left(), offset);
+  if (!read || offset != 0) return result;
+  auto &name = static_cast<cdk::variable_node*>(read->lvalue())->name();
+  if (!steps.count(name)) return result;
+
+  bool exact = dynamic_cast<cdk::ne_node*>(comparison)
+      || (dynamic_cast<cdk::lt_node*>(comparison) && steps[name] == 1)
+      || (dynamic_cast<cdk::gt_node*>(comparison) && steps[name] == -1);
+  if (!exact) return result;
+
+  auto bound = comparison->right();
+  if (!invariant_bound(bound)) return result;
+
+  // reads of i: the condition, its own increment and the reduced accesses
+  if (_reads[name] != uses[name] + 2 || !declares(loop->initializers(), name)) return result;
+
+  for (size_t ix = 0; ix < result.pointers.size(); ix++) {
+    if (static_cast<cdk::variable_node*>(result.pointers[ix].index->lvalue())->name() == name) {
+      result.test = ix;
+      result.bound = bound;
+      result.dropIncrements = true;
+      break;
+    }
+  }
+  return result;
+}
+
+/** The value of the variable set by the loop's initializers, when it is a constant. */
+static bool start_of(og::for_node *const loop, const std::string &name, long long &start) {
+  cdk::expression_node *value = nullptr;
+  if (auto sequence = dynamic_cast<cdk::sequence_node*>(loop->initializers())) {
+    auto declaration = sequence->size() == 1 ? dynamic_cast<og::variable_declaration_node*>(sequence->node(0)) : nullptr;
+    if (declaration && declaration->identifiers().size() == 1 && declaration->identifiers()[0] == name) {
+      value = declaration->initializer();
+    }
+  } else if (auto evaluation = dynamic_cast<og::evaluation_node*>(loop->initializers())) {
+    auto tuple = dynamic_cast<og::tuple_node*>(evaluation->argument());
+    auto assignment = tuple && tuple->size() == 1 ? dynamic_cast<cdk::assignment_node*>(tuple->element(0)) : nullptr;
+    auto variable = assignment ? dynamic_cast<cdk::variable_node*>(assignment->lvalue()) : nullptr;
+    if (variable && variable->name() == name) value = assignment->rvalue();
+  }
+
+  auto literal = dynamic_cast<cdk::integer_node*>(value);
+  if (!literal) return false;
+  start = literal->value();
+  return true;
+}
+
+og::loop_invariant_finder::loop_count og::loop_invariant_finder::counted(og::for_node *const loop) {
+  loop_count result;
+  auto increments = increments_of(loop);
+  auto comparison = comparison_of(loop);
+  if (!increments || increments->size() != 1 || !comparison) return result;
+
+  int offset;
+  auto read = linear(comparison->left(), offset);
+  if (!read || offset != 0 || !invariant_bound(comparison->right())) return result;
+  auto &name = static_cast<cdk::variable_node*>(read->lvalue())->name();
+  auto steps = induction_steps(loop);
+  if (!steps.count(name) || steps[name] == 0) return result;
+
+  int step = steps[name];
+  bool up = dynamic_cast<cdk::lt_node*>(comparison) || dynamic_cast<cdk::le_node*>(comparison);
+  bool down = dynamic_cast<cdk::gt_node*>(comparison) || dynamic_cast<cdk::ge_node*>(comparison);
+  bool ne = dynamic_cast<cdk::ne_node*>(comparison);
+  if (!((up && step > 0) || (down && step < 0) || (ne && (step == 1 || step == -1)))) return result;
+
+  result.variable = name;
+  result.condition = comparison;
+  result.step = step;
+
+  size_t reduced = 0;
+  for (auto &pointer : inductions(loop).pointers) {
+    if (static_cast<cdk::variable_node*>(pointer.index->lvalue())->name() == name) reduced += pointer.accesses.size();
+  }
+  result.indexOnly = (size_t)_reads[name] == reduced + 2;
+
+  // the trip count, unless the last increment would overflow
+  long long start;
+  auto bound = dynamic_cast<cdk::integer_node*>(comparison->right());
+  if (!bound || !start_of(loop, name, start)) return result;
+  long long distance = ((long long)bound->value() - start) * (step > 0 ? 1 : -1);
+  long long stride = step > 0 ? step : -(long long)step;
+  long long trips;
+  if (ne) {
+    trips = distance >= 0 ? distance : -1;
+  } else if (dynamic_cast<cdk::le_node*>(comparison) || dynamic_cast<cdk::ge_node*>(comparison)) {
+    trips = distance >= 0 ? distance / stride + 1 : 0;
+  } else {
+    trips = distance > 0 ? (distance + stride - 1) / stride : 0;
+  }
+  long long last = start + trips * step;
+  if (trips >= 0 && last >= INT32_MIN && last <= INT32_MAX) result.trips = trips;
+  return result;
+}
+
+bool og::loop_invariant_finder::pure() {
+  if (_stores || _loads || _impure || _io || _globals || _allocs) return false;
+  for (auto &name : _assigned) {
+    if (may_be_global(name)) return false;
+  }
+  return true;
+}
+
+/**
+ * Whether the scanned code leaves the named variables as they are (neither
+ * assigned nor declared, and their address not taken) and cannot change
+ * memory it does not name (no stores through pointers, no impure calls).
+ */
+bool og::loop_invariant_finder::preserves(const std::vector<std::string> &names) {
+  if (_stores || _impure) return false;
+  for (auto &name : names) {
+    if (_assigned.count(name) || _escaped.count(name)) return false;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+bool og::loop_invariant_finder::may_be_global(const std::string &name) {
+  auto symbol = _symtab.find(name);
+  return symbol && symbol->global();
+}
+
+bool og::loop_invariant_finder::invariant_variable(const std::string &name) {
+  bool shared = may_be_global(name) || _escaped.count(name);
+  return !_assigned.count(name) && !(shared && (_stores || _impure));
+}
+
+/** Constants, invariant variables and expressions hoisted out of the loop. */
+bool og::loop_invariant_finder::invariant_bound(cdk::expression_node *const expr) {
+  auto rvalue = dynamic_cast<cdk::rvalue_node*>(expr);
+  auto variable = rvalue ? dynamic_cast<cdk::variable_node*>(rvalue->lvalue()) : nullptr;
+  return dynamic_cast<cdk::integer_node*>(expr) || _hoisted.count(expr)
+      || std::find(_candidates.begin(), _candidates.end(), expr) != _candidates.end()
+      || (variable && invariant_variable(variable->name()));
+}
+
+/** Matches "i", "i + k", "k + i" and "i - k", returning the read of i. */
+cdk::rvalue_node *og::loop_invariant_finder::linear(cdk::expression_node *const expr, int &offset) {
+  auto read = [](cdk::expression_node *const node) -> cdk::rvalue_node* {
+    auto rvalue = dynamic_cast<cdk::rvalue_node*>(node);
+    if (!rvalue || !rvalue->is_typed(cdk::TYPE_INT) || !dynamic_cast<cdk::variable_node*>(rvalue->lvalue())) return nullptr;
+    return rvalue;
+  };
+
+  offset = 0;
+  if (auto rvalue = read(expr)) return rvalue;
+
+  auto operation = dynamic_cast<cdk::binary_operation_node*>(expr);
+  if (!dynamic_cast<cdk::add_node*>(expr) && !dynamic_cast<cdk::sub_node*>(expr)) return nullptr;
+  bool subtract = dynamic_cast<cdk::sub_node*>(expr);
+
+  auto left = read(operation->left());
+  auto right = read(operation->right());
+  auto left_constant = dynamic_cast<cdk::integer_node*>(operation->left());
+  auto right_constant = dynamic_cast<cdk::integer_node*>(operation->right());
+  if (left && right_constant) {
+    offset = subtract ? -right_constant->value() : right_constant->value();
+    return left;
+  }
+  if (!subtract && left_constant && right) {
+    offset = left_constant->value();
+    return right;
+  }
+  return nullptr;
+}
+
+bool og::loop_invariant_finder::reuse(cdk::typed_node *const node) {
+  if (!_hoisted.count(node)) return false;
+  _invariant = true; // the value is already in a temporary
+  _safe = true;
+  return true;
+}
+
+void og::loop_invariant_finder::result(cdk::typed_node *const node, size_t first, bool invariant, bool safe) {
+  _invariant = invariant;
+  _safe = safe;
+
+  if (!invariant || !(safe || (_guaranteed && !_barrier))) return;
+  if (!node->is_typed(cdk::TYPE_INT) && !node->is_typed(cdk::TYPE_DOUBLE) && !node->is_typed(cdk::TYPE_POINTER)
+      && !node->is_typed(cdk::TYPE_STRING)) return;
+
+  // the whole expression moves, so its parts need not
+  _candidates.resize(first);
+  _candidates.push_back(node);
+}
+
+void og::loop_invariant_finder::binary(cdk::binary_operation_node *const node, bool traps) {
+  if (reuse(node)) return;
+  size_t first = _candidates.size();
+  node->left()->accept(this, 0);
+  bool invariant = _invariant, safe = _safe;
+  node->right()->accept(this, 0);
+  result(node, first, invariant && _invariant, safe && _safe && !traps);
+}
+
+void og::loop_invariant_finder::logical(cdk::binary_operation_node *const node) {
+  if (reuse(node)) return;
+  size_t first = _candidates.size();
+  node->left()->accept(this, 0);
+  bool invariant = _invariant, safe = _safe;
+
+  bool guaranteed = _guaranteed;
+  _guaranteed = false; // short-circuited
+  node->right()->accept(this, 0);
+  _guaranteed = guaranteed;
+
+  result(node, first, invariant && _invariant, safe && _safe);
+}
+
+void og::loop_invariant_finder::unary(cdk::unary_operation_node *const node) {
+  if (reuse(node)) return;
+  size_t first = _candidates.size();
+  node->argument()->accept(this, 0);
+  result(node, first, _invariant, _safe);
+}
+
+//---------------------------------------------------------------------------
+
+void og::loop_invariant_finder::do_nil_node(cdk::nil_node * const node, int lvl) {
+  // EMPTY
+}
+void og::loop_invariant_finder::do_data_node(cdk::data_node * const node, int lvl) {
+  // EMPTY
+}
+void og::loop_invariant_finder::do_integer_node(cdk::integer_node * const node, int lvl) {
+  _invariant = _safe = true;
+}
+void og::loop_invariant_finder::do_double_node(cdk::double_node * const node, int lvl) {
+  _invariant = _safe = true;
+}
+void og::loop_invariant_finder::do_string_node(cdk::string_node * const node, int lvl) {
+  _invariant = _safe = true;
+}
+void og::loop_invariant_finder::do_nullptr_node(og::nullptr_node * const node, int lvl) {
+  _invariant = _safe = true;
+}
+void og::loop_invariant_finder::do_sizeof_node(og::sizeof_node * const node, int lvl) {
+  _invariant = _safe = true; // the argument is not evaluated
+}
+
+void og::loop_invariant_finder::do_add_node(cdk::add_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_sub_node(cdk::sub_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_mul_node(cdk::mul_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_div_node(cdk::div_node * const node, int lvl) {
+  binary(node, true);
+}
+void og::loop_invariant_finder::do_mod_node(cdk::mod_node * const node, int lvl) {
+  binary(node, true);
+}
+void og::loop_invariant_finder::do_lt_node(cdk::lt_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_le_node(cdk::le_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_ge_node(cdk::ge_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_gt_node(cdk::gt_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_ne_node(cdk::ne_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_eq_node(cdk::eq_node * const node, int lvl) {
+  binary(node, false);
+}
+void og::loop_invariant_finder::do_and_node(cdk::and_node * const node, int lvl) {
+  logical(node);
+}
+void og::loop_invariant_finder::do_or_node(cdk::or_node * const node, int lvl) {
+  logical(node);
+}
+void og::loop_invariant_finder::do_neg_node(cdk::neg_node * const node, int lvl) {
+  if (dynamic_cast<cdk::integer_node*>(node->argument())) {
+    _invariant = _safe = true; // a constant, written as one
+    return;
+  }
+  unary(node);
+}
+void og::loop_invariant_finder::do_not_node(cdk::not_node * const node, int lvl) {
+  unary(node);
+}
+void og::loop_invariant_finder::do_identity_node(og::identity_node * const node, int lvl) {
+  node->argument()->accept(this, lvl);
+}
+
+//---------------------------------------------------------------------------
+
+void og::loop_invariant_finder::do_variable_node(cdk::variable_node * const node, int lvl) {
+  _invariant = _safe = true; // the address (reads are handled by do_rvalue_node)
+}
+
+void og::loop_invariant_finder::do_pointer_index_node(og::pointer_index_node * const node, int lvl) {
+  // the address of the element
+  if (reuse(node)) return;
+  if (!_inIncrements) _indexing.push_back(node);
+  size_t first = _candidates.size();
+  node->base()->accept(this, lvl);
+  bool invariant = _invariant, safe = _safe;
+  node->index()->accept(this, lvl);
+  result(node, first, invariant && _invariant, safe && _safe);
+}
+
+void og::loop_invariant_finder::do_tuple_index_node(og::tuple_index_node * const node, int lvl) {
+  node->base()->accept(this, lvl);
+  _invariant = _safe = false;
+}
+
+void og::loop_invariant_finder::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  if (reuse(node)) return;
+
+  if (auto variable = dynamic_cast<cdk::variable_node*>(node->lvalue())) {
+    const std::string &name = variable->name();
+    _globals = _globals || may_be_global(name);
+    _reads[name]++;
+    _invariant = invariant_variable(name);
+    _safe = true;
+    return; // a single read is not worth a temporary
+  }
+
+  size_t first = _candidates.size();
+  node->lvalue()->accept(this, lvl);
+  _loads = true;
+  if (dynamic_cast<og::pointer_index_node*>(node->lvalue())) {
+    result(node, first, _invariant && !_stores && !_impure, false);
+  } else {
+    _invariant = _safe = false;
+  }
+}
+
+void og::loop_invariant_finder::do_assignment_node(cdk::assignment_node * const node, int lvl) {
+  // globals and variables whose address is taken may also be read through pointers
+  auto shared = [this](const std::string &name) { return may_be_global(name) || _escaped.count(name); };
+  if (auto variable = dynamic_cast<cdk::variable_node*>(node->lvalue())) {
+    _assigned.insert(variable->name());
+    _writes[variable->name()]++;
+    if (shared(variable->name())) _stores = true;
+  } else {
+    _stores = true;
+    if (auto element = dynamic_cast<og::tuple_index_node*>(node->lvalue())) {
+      auto base = dynamic_cast<cdk::rvalue_node*>(element->base());
+      auto variable = base ? dynamic_cast<cdk::variable_node*>(base->lvalue()) : nullptr;
+      if (variable) {
+        _assigned.insert(variable->name());
+        _writes[variable->name()]++;
+      }
+    }
+  }
+
+  node->rvalue()->accept(this, lvl);
+  node->lvalue()->accept(this, lvl);
+  _invariant = _safe = false;
+}
+
+void og::loop_invariant_finder::do_address_of_node(og::address_of_node * const node, int lvl) {
+  if (auto variable = dynamic_cast<cdk::variable_node*>(node->lvalue())) {
+    _escaped.insert(variable->name());
+  } else if (auto element = dynamic_cast<og::tuple_index_node*>(node->lvalue())) {
+    auto base = dynamic_cast<cdk::rvalue_node*>(element->base());
+    auto variable = base ? dynamic_cast<cdk::variable_node*>(base->lvalue()) : nullptr;
+    if (variable) _escaped.insert(variable->name());
+  }
+  node->lvalue()->accept(this, lvl);
+}
+
+void og::loop_invariant_finder::do_stack_alloc_node(og::stack_alloc_node * const node, int lvl) {
+  node->argument()->accept(this, lvl);
+  _allocs = true;
+  _invariant = _safe = false;
+}
+
+void og::loop_invariant_finder::do_input_node(og::input_node * const node, int lvl) {
+  _io = _barrier = true;
+  _invariant = _safe = false;
+}
+
+void og::loop_invariant_finder::do_function_call_node(og::function_call_node * const node, int lvl) {
+  if (reuse(node)) return;
+  size_t first = _candidates.size();
+
+  bool pure = _pureFunctions.count(node->identifier());
+  bool invariant = pure;
+  if (node->arguments()) {
+    // same order as the writer: last argument first
+    auto &arguments = node->arguments()->elements();
+    for (auto it = arguments.rbegin(); it != arguments.rend(); it++) {
+      auto argument = static_cast<cdk::expression_node*>(*it);
+      argument->accept(this, lvl);
+      invariant = invariant && _invariant && !argument->is_typed(cdk::TYPE_STRUCT);
+    }
+  }
+
+  if (!pure) _impure = _barrier = true;
+  result(node, first, invariant && !node->is_typed(cdk::TYPE_STRUCT), false);
+}
+
+void og::loop_invariant_finder::do_tuple_node(og::tuple_node * const node, int lvl) {
+  if (node->size() == 1) {
+    node->element(0)->accept(this, lvl);
+    return;
+  }
+  for (auto element : node->elements()) {
+    element->accept(this, lvl);
+  }
+  _invariant = _safe = false;
+}
+
+//---------------------------------------------------------------------------
+
+void og::loop_invariant_finder::do_evaluation_node(og::evaluation_node * const node, int lvl) {
+  node->argument()->accept(this, lvl);
+}
+
+void og::loop_invariant_finder::do_write_node(og::write_node * const node, int lvl) {
+  node->argument()->accept(this, lvl);
+  _io = _barrier = true;
+}
+
+void og::loop_invariant_finder::do_variable_declaration_node(og::variable_declaration_node * const node, int lvl) {
+  for (auto &name : node->identifiers()) {
+    _assigned.insert(name);
+    _writes[name]++;
+  }
+  if (node->initializer()) node->initializer()->accept(this, lvl);
+}
+
+void og::loop_invariant_finder::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  for (auto child : node->nodes()) {
+    child->accept(this, lvl);
+    if (_barrier) _guaranteed = false;
+  }
+}
+
+void og::loop_invariant_finder::do_block_node(og::block_node * const node, int lvl) {
+  if (node->declarations()) node->declarations()->accept(this, lvl);
+  if (node->instructions()) node->instructions()->accept(this, lvl);
+}
+
+void og::loop_invariant_finder::do_if_node(og::if_node * const node, int lvl) {
+  node->condition()->accept(this, lvl);
+  bool guaranteed = _guaranteed;
+  _guaranteed = false;
+  node->block()->accept(this, lvl);
+  _guaranteed = guaranteed && !_barrier;
+}
+
+void og::loop_invariant_finder::do_if_else_node(og::if_else_node * const node, int lvl) {
+  node->condition()->accept(this, lvl);
+  bool guaranteed = _guaranteed;
+  _guaranteed = false;
+  node->thenblock()->accept(this, lvl);
+  if (node->elseblock()) node->elseblock()->accept(this, lvl);
+  _guaranteed = guaranteed && !_barrier;
+}
+
+void og::loop_invariant_finder::do_for_node(og::for_node * const node, int lvl) {
+  if (node->initializers()) node->initializers()->accept(this, lvl);
+  bool guaranteed = _guaranteed;
+  _guaranteed = false;
+  if (node->condition()) node->condition()->accept(this, lvl);
+  if (node->block()) node->block()->accept(this, lvl);
+  if (node->increments()) node->increments()->accept(this, lvl);
+  _guaranteed = guaranteed && !_barrier;
+}
+
+void og::loop_invariant_finder::do_break_node(og::break_node * const node, int lvl) {
+  _barrier = true;
+}
+
+void og::loop_invariant_finder::do_continue_node(og::continue_node * const node, int lvl) {
+  _barrier = true;
+}
+
+void og::loop_invariant_finder::do_return_node(og::return_node * const node, int lvl) {
+  _returns.push_back(node);
+  if (node->retval()) node->retval()->accept(this, lvl);
+  _barrier = true;
+}
+
+void og::loop_invariant_finder::do_function_declaration_node(og::function_declaration_node * const node, int lvl) {
+  // EMPTY
+}
+
+void og::loop_invariant_finder::do_function_definition_node(og::function_definition_node * const node, int lvl) {
+  // EMPTY
+}
@@ -0,0 +1,157 @@
+#ifndef __OG_TARGET_LOOP_INVARIANT_FINDER_H__
+#define __OG_TARGET_LOOP_INVARIANT_FINDER_H__
+
+#include "targets/basic_ast_visitor.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cdk/symbol_table.h>
+#include "targets/symbol.h"
+
+namespace og {
+
+  /**
+   * Finds the expressions of a for loop that compute the same value in every
+   * iteration, so that they can be evaluated once before the loop.
+   *
+   * Variables are told apart by name (shadowing only makes more of them
+   * variant). A variable read is invariant when the loop neither assigns nor
+   * declares it and, for globals and variables whose address is taken, when
+   * the loop neither stores through pointers nor calls impure functions.
+   * Memory loads follow the same rule. Calls are invariant when the callee is
+   * pure and the arguments are invariant.
+   *
+   * Loads, divisions and calls may trap: those are only moved when the loop
+   * would evaluate them in its first iteration, before any output.
+   *
+   * Indexing such as base[i + k], where i only changes by a constant in the
+   * loop's increments, can be replaced by a pointer that advances with i.
+   *
+   * Scanning a whole function body tells whether the function is pure (no
+   * side effects, and a result that depends only on its arguments) and which
+   * of its variables have their address taken.
+   */
+  class loop_invariant_finder: public basic_ast_visitor {
+  public:
+    /** A pointer that follows base[i] while the induction variable i advances. */
+    struct induction_pointer {
+      cdk::rvalue_node *index;    // a read of the induction variable
+      cdk::rvalue_node *base;     // invariant pointer variable
+      int step;                   // bytes per iteration
+      std::vector<std::pair<og::pointer_index_node*, int>> accesses; // base[i + k], with k in bytes
+    };
+
+    /** Strength reduction of a loop's indexing. */
+    struct loop_inductions {
+      std::vector<induction_pointer> pointers;
+      int test = -1;                         // pointer that replaces the condition "i < bound"...
+      cdk::expression_node *bound = nullptr; // ...by "pointer != &base[bound]"
+      bool dropIncrements = false;           // the induction variable is not used otherwise
+    };
+
+    /** A loop "i = start; i < bound; i = i + step" (or <=, >, >=, !=) where only the increment changes i. */
+    struct loop_count {
+      std::string variable;                  // empty when the loop is not counted
+      cdk::binary_operation_node *condition = nullptr;
+      int step = 0;
+      long long trips = -1;                  // iterations, when start and bound are constants
+      bool indexOnly = false;                // the block reads i only in strength-reduced indexing
+    };
+
+  private:
+    cdk::symbol_table<og::symbol> &_symtab;
+    const std::set<std::string> &_pureFunctions;
+    std::set<std::string> _escaped;             // address taken somewhere in the function
+    std::set<const cdk::typed_node*> _hoisted;  // already moved out of an enclosing loop
+
+    // effects of the scanned code
+    std::set<std::string> _assigned; // assigned or declared variables
+    bool _stores = false;   // through pointers (or into tuples)
+    bool _loads = false;    // through pointers (or from tuples)
+    bool _impure = false;   // calls to functions with possible side effects
+    bool _io = false;
+    bool _globals = false;  // reads of global variables
+    bool _allocs = false;
+
+    // the last expression visited
+    bool _invariant = true;
+    bool _safe = true; // cannot trap
+
+    bool _guaranteed = true; // runs whenever the loop body does
+    bool _barrier = false;   // jump, return or output seen: later code may not run (or must run after it)
+
+    std::vector<cdk::typed_node*> _candidates;
+    std::vector<og::return_node*> _returns;
+
+    // for induction variables (counted in the last pass only)
+    std::map<std::string, int> _reads, _writes;
+    std::vector<og::pointer_index_node*> _indexing; // in the condition and block
+    bool _inIncrements = false;
+
+  public:
+    loop_invariant_finder(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<og::symbol> &symtab,
+                          const std::set<std::string> &pureFunctions,
+                          const std::set<std::string> &escaped = {},
+                          const std::set<const cdk::typed_node*> &hoisted = {}) :
+        basic_ast_visitor(compiler), _symtab(symtab), _pureFunctions(pureFunctions), _escaped(escaped), _hoisted(hoisted) {
+    }
+
+  public:
+    ~loop_invariant_finder() {}
+
+  public:
+    /** Scan a function body (for pure() and escaped()). */
+    void scan(og::function_definition_node *const function);
+
+    /** Invariant expressions worth computing before the loop (none contains another). */
+    std::vector<cdk::typed_node*> find(og::for_node *const loop);
+
+    /** Pointers that can replace indexing by induction variables (after find()). */
+    loop_inductions inductions(og::for_node *const loop);
+
+    /** Whether the loop is counted, and how many times it runs (after find()). */
+    loop_count counted(og::for_node *const loop);
+
+    bool pure();
+    bool preserves(const std::vector<std::string> &names);
+
+    const std::set<std::string> &escaped() const {
+      return _escaped;
+    }
+
+    /** The return statements of the scanned code. */
+    const std::vector<og::return_node*> &returns() const {
+      return _returns;
+    }
+
+    /** Whether the scanned code allocates on the stack. */
+    bool allocates() const {
+      return _allocs;
+    }
+
+  private:
+    bool may_be_global(const std::string &name);
+    bool invariant_variable(const std::string &name);
+    cdk::rvalue_node *linear(cdk::expression_node *const expr, int &offset);
+    bool invariant_bound(cdk::expression_node *const expr);
+    std::map<std::string, int> induction_steps(og::for_node *const loop);
+    bool reuse(cdk::typed_node *const node);
+    void result(cdk::typed_node *const node, size_t first, bool invariant, bool safe);
+    void binary(cdk::binary_operation_node *const node, bool traps);
+    void logical(cdk::binary_operation_node *const node);
+    void unary(cdk::unary_operation_node *const node);
+
+  public:
+  // do not edit these lines
+#define __IN_VISITOR_HEADER__
+#include "ast/visitor_decls.h"       // automatically generated
+#undef __IN_VISITOR_HEADER__
+  // do not edit these lines: end
+
+  };
+
+} // og
+
+#endif
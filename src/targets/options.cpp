@@ -0,0 +1,34 @@
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include "targets/options.h"
+
+og::options::options() {
+  const char *flags = std::getenv("OGFLAGS");
+  if (!flags) return;
+
+  std::istringstream words(flags);
+  std::string option;
+  while (words >> option) {
+    parse(option);
+  }
+}
+
+const og::options &og::options::get() {
+  static const options self;
+  return self;
+}
+
+void og::options::parse(const std::string &option) {
+  if (option == "--unroll") {
+    _unroll = 4;
+  } else if (option.rfind("--unroll=", 0) == 0) {
+    int factor = std::atoi(option.c_str() + 9);
+    for (_unroll = 1; _unroll * 2 <= factor; _unroll *= 2);
+    if (_unroll < 2) _unroll = 0;
+  } else if (option == "--sse2") {
+    _sse2 = true;
+  } else {
+    std::cerr << "warning: OGFLAGS: unknown option " << option << std::endl;
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef __OG_TARGETS_OPTIONS_H__
+#define __OG_TARGETS_OPTIONS_H__
+
+#include <string>
+
+namespace og {
+
+  /**
+   * Code generation options. The command line belongs to the CDK driver, so
+   * these are read from the OGFLAGS environment variable (space-separated):
+   *
+   *   --unroll      unroll counted for loops (by up to 4)
+   *   --unroll=N    unroll counted for loops by up to N (a power of 2)
+   *   --sse2        compute with reals in SSE2 registers (instead of the x87 stack)
+   */
+  class options {
+    int _unroll = 0; // maximum unrolling factor (0: no unrolling)
+    bool _sse2 = false;
+
+  private:
+    options();
+
+  public:
+    static const options &get();
+
+    int unroll() const {
+      return _unroll;
+    }
+
+    bool sse2() const {
+      return _sse2;
+    }
+
+  private:
+    void parse(const std::string &option);
+  };
+
+} // og
+
+#endif
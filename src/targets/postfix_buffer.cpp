@@ -0,0 +1,94 @@
+#include "targets/postfix_buffer.h"
+
+void og::postfix_buffer::replay(const postfix_instruction &instruction, cdk::basic_postfix_emitter &pf, std::ostream &os) {
+  switch (instruction.op) {
+#define OG_POSTFIX_REPLAY_NOARG(OP) case postfix_opcode::OP: pf.OP(); break;
+#define OG_POSTFIX_REPLAY_INT(OP) case postfix_opcode::OP: pf.OP(instruction.ival); break;
+#define OG_POSTFIX_REPLAY_STRING(OP) case postfix_opcode::OP: pf.OP(instruction.sval); break;
+#define OG_POSTFIX_REPLAY_DOUBLE(OP) case postfix_opcode::OP: pf.OP(instruction.dval); break;
+
+    OG_POSTFIX_OPS_NOARG(OG_POSTFIX_REPLAY_NOARG)
+    OG_POSTFIX_OPS_INT(OG_POSTFIX_REPLAY_INT)
+    OG_POSTFIX_OPS_STRING(OG_POSTFIX_REPLAY_STRING)
+    OG_POSTFIX_OPS_DOUBLE(OG_POSTFIX_REPLAY_DOUBLE)
+
+#undef OG_POSTFIX_REPLAY_NOARG
+#undef OG_POSTFIX_REPLAY_INT
+#undef OG_POSTFIX_REPLAY_STRING
+#undef OG_POSTFIX_REPLAY_DOUBLE
+
+    case postfix_opcode::GLOBAL:
+      if (instruction.sval2 == "function") {
+        pf.GLOBAL(instruction.sval, pf.FUNC());
+      } else {
+        pf.GLOBAL(instruction.sval, pf.OBJ());
+      }
+      break;
+    case postfix_opcode::COMMENT:
+      os << "        ;; " << instruction.sval << std::endl;
+      break;
+    case postfix_opcode::STFVALPAIR:
+      os << "\tpop\teax" << std::endl << "\tpop\tedx" << std::endl;
+      break;
+    case postfix_opcode::LDFVALPAIR:
+      os << "\tpush\tedx" << std::endl << "\tpush\teax" << std::endl;
+      break;
+    case postfix_opcode::STARGS:
+      os << "\tpop\tecx" << std::endl;
+      if (instruction.ival == 2) os << "\tpop\tedx" << std::endl;
+      break;
+    case postfix_opcode::LDARGS:
+      if (instruction.ival == 2) os << "\tpush\tedx" << std::endl;
+      os << "\tpush\tecx" << std::endl;
+      break;
+    case postfix_opcode::ALIGN8:
+      os << "align\t8" << std::endl;
+      break;
+    case postfix_opcode::JTABLE:
+      os << "\tpop\teax" << std::endl << "\tcmp\teax, " << instruction.labels.size() << std::endl
+         << "\tjae\tnear " << instruction.sval2 << std::endl
+         << "\tjmp\tdword [" << instruction.sval << "+eax*4]" << std::endl;
+      jump_table(instruction, pf);
+      break;
+  }
+}
+
+void og::postfix_buffer::jump_table(const postfix_instruction &instruction, cdk::basic_postfix_emitter &pf) {
+  pf.RODATA();
+  pf.ALIGN();
+  pf.LABEL(instruction.sval);
+  for (auto &label : instruction.labels) {
+    pf.SADDR(label);
+  }
+  pf.TEXT();
+}
+
+// see postfix_writer::do_function_definition_node
+bool og::postfix_buffer::starts_function(const std::vector<postfix_instruction> &code, size_t ix) {
+  if (ix >= code.size() || code[ix].op != postfix_opcode::TEXT) return false;
+  ix++;
+  while (ix < code.size() && (code[ix].op == postfix_opcode::ALIGN || code[ix].op == postfix_opcode::GLOBAL)) {
+    ix++;
+  }
+  return ix + 1 < code.size() && code[ix].op == postfix_opcode::LABEL && code[ix + 1].op == postfix_opcode::ENTER;
+}
+
+const char *og::postfix_buffer::name(postfix_opcode op) {
+  switch (op) {
+#define OG_POSTFIX_NAME(OP) case postfix_opcode::OP: return #OP;
+    OG_POSTFIX_OPS_NOARG(OG_POSTFIX_NAME)
+    OG_POSTFIX_OPS_INT(OG_POSTFIX_NAME)
+    OG_POSTFIX_OPS_STRING(OG_POSTFIX_NAME)
+    OG_POSTFIX_OPS_DOUBLE(OG_POSTFIX_NAME)
+#undef OG_POSTFIX_NAME
+    case postfix_opcode::GLOBAL: return "GLOBAL";
+    case postfix_opcode::COMMENT: return "COMMENT";
+    case postfix_opcode::STFVALPAIR: return "STFVALPAIR";
+    case postfix_opcode::LDFVALPAIR: return "LDFVALPAIR";
+    case postfix_opcode::STARGS: return "STARGS";
+    case postfix_opcode::LDARGS: return "LDARGS";
+    case postfix_opcode::ALIGN8: return "ALIGN8";
+    case postfix_opcode::JTABLE: return "JTABLE";
+  }
+  return "?";
+}
@@ -0,0 +1,160 @@
+#ifndef __OG_TARGETS_POSTFIX_BUFFER_H__
+#define __OG_TARGETS_POSTFIX_BUFFER_H__
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cdk/emitters/basic_postfix_emitter.h>
+
+namespace og {
+
+// postfix instructions without arguments
+#define OG_POSTFIX_OPS_NOARG(X) \
+  X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(NEG) X(NOT) X(AND) X(OR) X(XOR) \
+  X(EQ) X(NE) X(LT) X(LE) X(GT) X(GE) X(SHTL) X(SHTRU) X(SHTRS) \
+  X(DADD) X(DSUB) X(DMUL) X(DDIV) X(DNEG) X(DCMP) X(I2D) X(D2I) \
+  X(LDINT) X(LDDOUBLE) X(STINT) X(STDOUBLE) X(SP) X(ALLOC) \
+  X(DUP32) X(DUP64) X(SWAP32) X(SWAP64) X(LEAVE) X(RET) \
+  X(STFVAL32) X(STFVAL64) X(LDFVAL32) X(LDFVAL64) \
+  X(TEXT) X(DATA) X(RODATA) X(BSS) X(ALIGN) X(NOP)
+
+// postfix instructions with an integer argument
+#define OG_POSTFIX_OPS_INT(X) \
+  X(INT) X(LOCAL) X(LOCV) X(LOCA) X(TRASH) X(ENTER) X(RETN) X(SINT) X(SALLOC)
+
+// postfix instructions with a label/name/string argument
+#define OG_POSTFIX_OPS_STRING(X) \
+  X(ADDR) X(ADDRV) X(ADDRA) X(CALL) X(JMP) X(JZ) X(JNZ) \
+  X(JEQ) X(JNE) X(JLT) X(JLE) X(JGT) X(JGE) \
+  X(LABEL) X(EXTERN) X(SADDR) X(SSTRING)
+
+// postfix instructions with a real argument
+#define OG_POSTFIX_OPS_DOUBLE(X) \
+  X(DOUBLE) X(SDOUBLE)
+
+#define OG_POSTFIX_OPCODE(OP) OP,
+
+  enum class postfix_opcode {
+    OG_POSTFIX_OPS_NOARG(OG_POSTFIX_OPCODE)
+    OG_POSTFIX_OPS_INT(OG_POSTFIX_OPCODE)
+    OG_POSTFIX_OPS_STRING(OG_POSTFIX_OPCODE)
+    OG_POSTFIX_OPS_DOUBLE(OG_POSTFIX_OPCODE)
+    GLOBAL,
+    COMMENT,
+    STFVALPAIR, // return a two-word value in eax (top of the stack) and edx
+    LDFVALPAIR, // push the two-word value returned in eax:edx
+    STARGS,     // pop the first (ival) argument words into ecx (top of the stack) and edx, before a CALL
+    LDARGS,     // push the (ival) argument words received in ecx (on top) and edx, after ENTER
+    ALIGN8,     // align the next datum to 8 bytes (ALIGN only aligns to 4), for real values
+    JTABLE,     // pop an index: goto labels[index] (through the table sval, in rodata), or to sval2 when out of range
+  };
+
+#undef OG_POSTFIX_OPCODE
+
+  struct postfix_instruction {
+    postfix_opcode op;
+    int ival;
+    double dval;
+    std::string sval;  // label, symbol, string literal or comment
+    std::string sval2; // symbol type (GLOBAL only), default label (JTABLE only)
+    std::vector<std::string> labels; // JTABLE only
+
+    postfix_instruction(postfix_opcode op, int ival = 0, double dval = 0, const std::string &sval = "", const std::string &sval2 = "") :
+        op(op), ival(ival), dval(dval), sval(sval), sval2(sval2) {
+    }
+  };
+
+  /**
+   * Postfix code, as emitted by postfix_writer, kept in memory so that it can be
+   * inspected and rewritten before it is handed to an actual emitter.
+   * Mirrors the subset of cdk::basic_postfix_emitter that og uses.
+   */
+  class postfix_buffer {
+    std::vector<postfix_instruction> _code;
+
+  public:
+    std::vector<postfix_instruction> &code() {
+      return _code;
+    }
+    const std::vector<postfix_instruction> &code() const {
+      return _code;
+    }
+
+    void emit(const postfix_instruction &instruction) {
+      _code.push_back(instruction);
+    }
+
+  public:
+#define OG_POSTFIX_EMIT_NOARG(OP) void OP() { emit({postfix_opcode::OP}); }
+#define OG_POSTFIX_EMIT_INT(OP) void OP(int value) { emit({postfix_opcode::OP, value}); }
+#define OG_POSTFIX_EMIT_STRING(OP) void OP(const std::string &value) { emit({postfix_opcode::OP, 0, 0, value}); }
+#define OG_POSTFIX_EMIT_DOUBLE(OP) void OP(double value) { emit({postfix_opcode::OP, 0, value}); }
+
+    OG_POSTFIX_OPS_NOARG(OG_POSTFIX_EMIT_NOARG)
+    OG_POSTFIX_OPS_INT(OG_POSTFIX_EMIT_INT)
+    OG_POSTFIX_OPS_STRING(OG_POSTFIX_EMIT_STRING)
+    OG_POSTFIX_OPS_DOUBLE(OG_POSTFIX_EMIT_DOUBLE)
+
+#undef OG_POSTFIX_EMIT_NOARG
+#undef OG_POSTFIX_EMIT_INT
+#undef OG_POSTFIX_EMIT_STRING
+#undef OG_POSTFIX_EMIT_DOUBLE
+
+    void GLOBAL(const std::string &name, const std::string &type) {
+      emit({postfix_opcode::GLOBAL, 0, 0, name, type});
+    }
+    void COMMENT(const std::string &text) {
+      emit({postfix_opcode::COMMENT, 0, 0, text});
+    }
+    void STFVALPAIR() {
+      emit({postfix_opcode::STFVALPAIR});
+    }
+    void LDFVALPAIR() {
+      emit({postfix_opcode::LDFVALPAIR});
+    }
+    void STARGS(int words) {
+      emit({postfix_opcode::STARGS, words});
+    }
+    void LDARGS(int words) {
+      emit({postfix_opcode::LDARGS, words});
+    }
+    void ALIGN8() {
+      emit({postfix_opcode::ALIGN8});
+    }
+    void JTABLE(const std::string &table, const std::vector<std::string> &labels, const std::string &otherwise) {
+      postfix_instruction instruction(postfix_opcode::JTABLE, 0, 0, table, otherwise);
+      instruction.labels = labels;
+      emit(instruction);
+    }
+
+    // symbol types, translated into the emitter's own on replay
+    std::string FUNC() {
+      return "function";
+    }
+    std::string OBJ() {
+      return "object";
+    }
+
+  public:
+    /** Send one instruction to an emitter (comments and og's own instructions are written directly to os). */
+    static void replay(const postfix_instruction &instruction, cdk::basic_postfix_emitter &pf, std::ostream &os);
+
+    void replay(cdk::basic_postfix_emitter &pf, std::ostream &os) const {
+      for (auto &instruction : _code) {
+        replay(instruction, pf, os);
+      }
+    }
+
+    /** Write a JTABLE's table (and return to the text segment). */
+    static void jump_table(const postfix_instruction &instruction, cdk::basic_postfix_emitter &pf);
+
+    /** Whether a function (TEXT ALIGN [GLOBAL] LABEL ENTER) starts at the TEXT in position ix. */
+    static bool starts_function(const std::vector<postfix_instruction> &code, size_t ix);
+
+    /** Name of an opcode, as in the emitter's interface. */
+    static const char *name(postfix_opcode op);
+  };
+
+} // og
+
+#endif
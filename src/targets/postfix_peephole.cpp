@@ -0,0 +1,182 @@
+#include <cstdint>
+#include "targets/postfix_peephole.h"
+
+typedef og::postfix_opcode op;
+typedef og::postfix_instruction instr;
+
+static bool is(const instr &instruction, op opcode) {
+  return instruction.op == opcode;
+}
+
+static bool is_int(const instr &instruction, int value) {
+  return instruction.op == op::INT && instruction.ival == value;
+}
+
+static int log2_exact(int value) {
+  if (value < 2 || (value & (value - 1)) != 0) return -1;
+  int bits = 0;
+  while (value > 1) {
+    value >>= 1;
+    bits++;
+  }
+  return bits;
+}
+
+const std::vector<og::postfix_peephole::rule> &og::postfix_peephole::rules() {
+  static const std::vector<rule> table = {
+    // x + 0, x - 0, x * 1, x / 1
+    { "add-zero", 2,
+      [](const instr *w) { return is_int(w[0], 0) && (is(w[1], op::ADD) || is(w[1], op::SUB)); },
+      [](const instr *w) { return std::vector<instr>(); } },
+    { "mul-one", 2,
+      [](const instr *w) { return is_int(w[0], 1) && (is(w[1], op::MUL) || is(w[1], op::DIV)); },
+      [](const instr *w) { return std::vector<instr>(); } },
+
+    // constant arithmetic (addresses and sizes)
+    { "fold-int", 3,
+      [](const instr *w) {
+        return is(w[0], op::INT) && is(w[1], op::INT) && (is(w[2], op::ADD) || is(w[2], op::SUB) || is(w[2], op::MUL));
+      },
+      [](const instr *w) {
+        uint32_t a = w[0].ival, b = w[1].ival;
+        uint32_t value = is(w[2], op::ADD) ? a + b : is(w[2], op::SUB) ? a - b : a * b;
+        return std::vector<instr> { instr(op::INT, (int)value) };
+      } },
+    { "fold-offsets", 4,
+      [](const instr *w) { return is(w[0], op::INT) && is(w[1], op::ADD) && is(w[2], op::INT) && is(w[3], op::ADD); },
+      [](const instr *w) {
+        return std::vector<instr> { instr(op::INT, (int)((uint32_t)w[0].ival + (uint32_t)w[2].ival)), instr(op::ADD) };
+      } },
+    { "fold-local", 3,
+      [](const instr *w) { return is(w[0], op::LOCAL) && is(w[1], op::INT) && is(w[2], op::ADD); },
+      [](const instr *w) { return std::vector<instr> { instr(op::LOCAL, w[0].ival + w[1].ival) }; } },
+
+    // x * 2^k
+    { "mul-shift", 2,
+      [](const instr *w) { return is(w[0], op::INT) && log2_exact(w[0].ival) > 0 && is(w[1], op::MUL); },
+      [](const instr *w) { return std::vector<instr> { instr(op::INT, log2_exact(w[0].ival)), instr(op::SHTL) }; } },
+
+    // x / 2^k and x % 2^k: negative dividends are biased by 2^k - 1 (x >> 31 >>> 32 - k) to round towards zero
+    { "div-shift", 2,
+      [](const instr *w) { return is(w[0], op::INT) && log2_exact(w[0].ival) > 0 && is(w[1], op::DIV); },
+      [](const instr *w) {
+        int k = log2_exact(w[0].ival);
+        return std::vector<instr> { instr(op::DUP32), instr(op::INT, 31), instr(op::SHTRS), instr(op::INT, 32 - k),
+                                    instr(op::SHTRU), instr(op::ADD), instr(op::INT, k), instr(op::SHTRS) };
+      } },
+    { "mod-mask", 2,
+      [](const instr *w) { return is(w[0], op::INT) && log2_exact(w[0].ival) > 0 && is(w[1], op::MOD); },
+      [](const instr *w) {
+        int k = log2_exact(w[0].ival);
+        return std::vector<instr> { instr(op::DUP32), instr(op::DUP32), instr(op::INT, 31), instr(op::SHTRS),
+                                    instr(op::INT, 32 - k), instr(op::SHTRU), instr(op::ADD), instr(op::INT, -w[0].ival),
+                                    instr(op::AND), instr(op::SUB) };
+      } },
+
+    // direct frame/global access
+    { "locv", 2,
+      [](const instr *w) { return is(w[0], op::LOCAL) && is(w[1], op::LDINT); },
+      [](const instr *w) { return std::vector<instr> { instr(op::LOCV, w[0].ival) }; } },
+    { "loca", 2,
+      [](const instr *w) { return is(w[0], op::LOCAL) && is(w[1], op::STINT); },
+      [](const instr *w) { return std::vector<instr> { instr(op::LOCA, w[0].ival) }; } },
+    { "addrv", 2,
+      [](const instr *w) { return is(w[0], op::ADDR) && is(w[1], op::LDINT); },
+      [](const instr *w) { return std::vector<instr> { instr(op::ADDRV, 0, 0, w[0].sval) }; } },
+    { "addra", 2,
+      [](const instr *w) { return is(w[0], op::ADDR) && is(w[1], op::STINT); },
+      [](const instr *w) { return std::vector<instr> { instr(op::ADDRA, 0, 0, w[0].sval) }; } },
+
+    // assignment whose value is discarded
+    { "dup-store-trash", 3,
+      [](const instr *w) {
+        return is(w[0], op::DUP32) && (is(w[1], op::LOCA) || is(w[1], op::ADDRA)) && is(w[2], op::TRASH) && w[2].ival >= 4;
+      },
+      [](const instr *w) {
+        std::vector<instr> result { w[1] };
+        if (w[2].ival > 4) result.push_back(instr(op::TRASH, w[2].ival - 4));
+        return result;
+      } },
+    { "trash-merge", 2,
+      [](const instr *w) { return is(w[0], op::TRASH) && is(w[1], op::TRASH); },
+      [](const instr *w) { return std::vector<instr> { instr(op::TRASH, w[0].ival + w[1].ival) }; } },
+
+    // jump to the next instruction
+    { "jump-next", 2,
+      [](const instr *w) { return is(w[0], op::JMP) && is(w[1], op::LABEL) && w[0].sval == w[1].sval; },
+      [](const instr *w) { return std::vector<instr> { w[1] }; } },
+  };
+  return table;
+}
+
+void og::postfix_peephole::optimize(std::vector<postfix_instruction> &code) {
+  static const size_t longest = 4;
+
+  std::vector<size_t> positions; // of non-comment instructions
+  auto locate = [&]() {
+    positions.clear();
+    for (size_t ix = 0; ix < code.size(); ix++) {
+      if (!is(code[ix], op::COMMENT)) positions.push_back(ix);
+    }
+  };
+  locate();
+
+  for (size_t k = 0; k < positions.size();) {
+    bool applied = false;
+    for (auto &r : rules()) {
+      if (k + r.size > positions.size()) continue;
+
+      std::vector<instr> window;
+      for (size_t j = 0; j < r.size; j++) {
+        window.push_back(code[positions[k + j]]);
+      }
+      if (!r.matches(window.data())) continue;
+
+      // comments inside the matched range are kept in front
+      size_t from = positions[k], to = positions[k + r.size - 1];
+      std::vector<instr> replacement;
+      for (size_t ix = from; ix <= to; ix++) {
+        if (is(code[ix], op::COMMENT)) replacement.push_back(code[ix]);
+      }
+      for (auto &instruction : r.rewrite(window.data())) {
+        replacement.push_back(instruction);
+      }
+      code.erase(code.begin() + from, code.begin() + to + 1);
+      code.insert(code.begin() + from, replacement.begin(), replacement.end());
+
+      _fired[r.name]++;
+      applied = true;
+      break;
+    }
+
+    if (applied) {
+      // the rewritten code may complete a pattern that started earlier
+      locate();
+      k = k >= longest - 1 ? k - (longest - 1) : 0;
+    } else {
+      k++;
+    }
+  }
+}
+
+void og::postfix_peephole::run(postfix_buffer &buffer) {
+  auto &code = buffer.code();
+  std::vector<postfix_instruction> result;
+
+  size_t ix = 0;
+  while (ix < code.size()) {
+    if (!postfix_buffer::starts_function(code, ix)) {
+      result.push_back(code[ix++]);
+      continue;
+    }
+
+    std::vector<postfix_instruction> function { code[ix++] };
+    while (ix < code.size() && !postfix_buffer::starts_function(code, ix)) {
+      function.push_back(code[ix++]);
+    }
+    optimize(function);
+    result.insert(result.end(), function.begin(), function.end());
+  }
+
+  code = result;
+}
@@ -0,0 +1,50 @@
+#ifndef __OG_TARGETS_POSTFIX_PEEPHOLE_H__
+#define __OG_TARGETS_POSTFIX_PEEPHOLE_H__
+
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "targets/postfix_buffer.h"
+
+namespace og {
+
+  /**
+   * Rewrites short sequences of postfix instructions (the writer's usual
+   * redundancies) into cheaper equivalents, one function at a time.
+   * Comments are ignored when matching and kept before the rewritten code.
+   */
+  class postfix_peephole {
+    struct rule {
+      const char *name;
+      size_t size; // instructions matched
+      std::function<bool(const postfix_instruction *window)> matches;
+      std::function<std::vector<postfix_instruction>(const postfix_instruction *window)> rewrite;
+    };
+
+    static const std::vector<rule> &rules();
+
+    std::map<std::string, int> _fired; // rule name -> times applied
+
+  public:
+    void run(postfix_buffer &buffer);
+
+    const std::map<std::string, int> &fired() const {
+      return _fired;
+    }
+
+    /** Print how many times each rule fired. */
+    void report(std::ostream &os) const {
+      for (auto &entry : _fired) {
+        os << "peephole: " << entry.first << ": " << entry.second << std::endl;
+      }
+    }
+
+  private:
+    void optimize(std::vector<postfix_instruction> &code);
+  };
+
+} // og
+
+#endif
@@ -4,6 +4,8 @@
 #include <cdk/targets/basic_target.h>
 #include <cdk/ast/basic_node.h>
 #include "targets/postfix_writer.h"
+#include "targets/postfix_tos_emitter.h"
+#include "targets/postfix_peephole.h"
 
 #include <cdk/emitters/postfix_ix86_emitter.h>
 
@@ -23,15 +25,25 @@ namespace og {
       // during code generation
       cdk::symbol_table<og::symbol> symtab;
 
-      // this is the backend postfix machine
-      cdk::postfix_ix86_emitter pf(compiler);
+      // postfix code is generated into memory first
+      postfix_buffer buffer;
 
-      // generate assembly code from the syntax tree
-      postfix_writer writer(compiler, symtab, pf);
+      // generate postfix code from the syntax tree
+      postfix_writer writer(compiler, symtab, buffer);
       compiler->ast()->accept(&writer, 0);
 
       for (std::string ext : writer.extern_functions())
-        pf.EXTERN(ext);
+        buffer.EXTERN(ext);
+
+      postfix_peephole peephole;
+      peephole.run(buffer);
+      if (compiler->debug()) peephole.report(std::cerr);
+
+      // this is the backend postfix machine
+      // (with the top of the stack kept in registers)
+      cdk::postfix_ix86_emitter pf(compiler);
+      postfix_tos_emitter tos(pf, *compiler->ostream());
+      tos.emit(buffer);
 
       return true;
     }
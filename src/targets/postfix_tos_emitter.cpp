@@ -0,0 +1,685 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "targets/postfix_tos_emitter.h"
+#include "targets/constant_division.h"
+
+static std::string frame(int offset) {
+  if (offset < 0) return "[ebp-" + std::to_string(-offset) + "]";
+  return "[ebp+" + std::to_string(offset) + "]";
+}
+
+// low byte of eax, ecx or edx
+static std::string low(const std::string &reg) {
+  return reg.substr(1, 1) + "l";
+}
+
+//---------------------------------------------------------------------------
+//     CACHE
+//---------------------------------------------------------------------------
+
+void og::postfix_tos_emitter::flush() {
+  settle();
+  spill_doubles();
+  for (auto &reg : _cache) {
+    o("push", reg);
+  }
+  _cache.clear();
+}
+
+bool og::postfix_tos_emitter::taken(const std::string &reg) const {
+  return std::find(_cache.begin(), _cache.end(), reg) != _cache.end()
+      || std::find(_arguments.begin(), _arguments.end(), reg) != _arguments.end();
+}
+
+std::string og::postfix_tos_emitter::allocate() {
+  // at most two cached values: the third one goes to memory
+  if (_cache.size() == 2 || (!_cache.empty() && _cache.size() + _arguments.size() == 3)) {
+    spill_doubles(); // they are below
+    o("push", _cache.front());
+    _cache.erase(_cache.begin());
+  }
+  for (auto reg : { "eax", "ecx", "edx" }) {
+    if (!taken(reg)) return reg;
+  }
+  return ""; // cannot happen
+}
+
+void og::postfix_tos_emitter::fetch(size_t count) {
+  // values below the cached ones come from the machine stack
+  if (_cache.size() < count) spill_doubles();
+  while (_cache.size() < count) {
+    for (auto reg : { "eax", "ecx", "edx" }) {
+      if (taken(reg)) continue;
+      o("pop", reg);
+      _cache.insert(_cache.begin(), reg);
+      break;
+    }
+  }
+}
+
+std::string og::postfix_tos_emitter::pop() {
+  fetch(1);
+  std::string reg = _cache.back();
+  _cache.pop_back();
+  return reg;
+}
+
+// move two cached values to the given registers, without overwriting either
+void og::postfix_tos_emitter::place(const std::string &a, const std::string &ra, const std::string &b,
+                                    const std::string &rb) {
+  if (a == rb && b == ra) {
+    o("xchg", ra + ", " + rb);
+  } else if (a == rb) {
+    o("mov", ra + ", " + a);
+    o("mov", rb + ", " + b);
+  } else {
+    if (b != rb) o("mov", rb + ", " + b);
+    if (a != ra) o("mov", ra + ", " + a);
+  }
+}
+
+// write the constant that was held back
+void og::postfix_tos_emitter::settle() {
+  if (_immediate) {
+    _immediate = false;
+    std::string reg = allocate();
+    if (_constant == 0) {
+      o("xor", reg + ", " + reg);
+    } else {
+      o("mov", reg + ", " + std::to_string(_constant));
+    }
+    push(reg);
+  } else if (_displaced) {
+    // not "add reg, k": in loops that keep variables in memory, that measured slower
+    _displaced = false;
+    std::string reg = allocate();
+    o("mov", reg + ", " + std::to_string(_constant));
+    push(reg);
+    binary("add");
+  } else if (_framed) {
+    _framed = false;
+    std::string reg = allocate();
+    o("lea", reg + ", " + frame(_constant));
+    push(reg);
+  }
+}
+
+static std::string address(const std::string &reg, int displacement) {
+  if (displacement == 0) return "[" + reg + "]";
+  if (displacement < 0) return "[" + reg + "-" + std::to_string(-displacement) + "]";
+  return "[" + reg + "+" + std::to_string(displacement) + "]";
+}
+
+// memory accesses through the address on top of the stack (plus a displacement)
+bool og::postfix_tos_emitter::access(const postfix_instruction &instruction, int displacement) {
+  std::string reg;
+
+  switch (instruction.op) {
+    case postfix_opcode::LDINT:
+      fetch(1);
+      o("mov", _cache.back() + ", dword " + address(_cache.back(), displacement));
+      return true;
+    case postfix_opcode::STINT:
+      fetch(2);
+      reg = pop();
+      o("mov", "dword " + address(reg, displacement) + ", " + pop());
+      return true;
+    case postfix_opcode::LDDOUBLE:
+      reg = pop();
+      if (_sse2) {
+        load_double("qword " + address(reg, displacement));
+        return true;
+      }
+      flush();
+      o("push", "dword " + address(reg, displacement + 4));
+      o("push", "dword " + address(reg, displacement));
+      return true;
+    case postfix_opcode::STDOUBLE:
+      reg = pop();
+      if (_sse2) {
+        store_double("qword " + address(reg, displacement));
+        return true;
+      }
+      flush();
+      o("pop", "dword " + address(reg, displacement));
+      o("pop", "dword " + address(reg, displacement + 4));
+      return true;
+    default:
+      return false;
+  }
+}
+
+//---------------------------------------------------------------------------
+//     OPERATIONS
+//---------------------------------------------------------------------------
+
+void og::postfix_tos_emitter::binary(const char *mnemonic) {
+  fetch(2);
+  std::string b = pop();
+  o(mnemonic, _cache.back() + ", " + b);
+}
+
+void og::postfix_tos_emitter::compare(const char *condition) {
+  fetch(2);
+  std::string b = pop();
+  std::string a = _cache.back();
+  o("cmp", a + ", " + b);
+  o(std::string("set") + condition, low(a));
+  o("movzx", a + ", " + low(a));
+}
+
+void og::postfix_tos_emitter::division(bool remainder) {
+  fetch(2);
+  std::string b = pop();
+  std::string a = pop();
+
+  // dividend to eax, divisor to ecx (edx is taken by the sign extension)
+  if (a == "ecx" && b == "eax") {
+    o("xchg", "eax, ecx");
+  } else {
+    if (b != "ecx") {
+      if (a == "ecx") {
+        o("mov", "eax, ecx");
+        a = "eax";
+      }
+      o("mov", "ecx, " + b);
+    }
+    if (a != "eax") o("mov", "eax, " + a);
+  }
+  o("cdq");
+  o("idiv", "ecx");
+  push(remainder ? "edx" : "eax");
+}
+
+// the quotient is computed in eax (the high word of the product goes to edx), the dividend is kept in ecx
+void og::postfix_tos_emitter::constant_division(int divisor, bool remainder) {
+  division_magic magic(divisor);
+  std::string n = pop();
+  if (!_cache.empty()) flush(); // all three registers are needed
+  if (n != "ecx") o("mov", "ecx, " + n);
+  o("mov", "eax, " + std::to_string(magic.multiplier));
+  o("imul", "ecx");
+  if (magic.correction(divisor) > 0) o("add", "edx, ecx");
+  if (magic.correction(divisor) < 0) o("sub", "edx, ecx");
+  if (magic.shift) o("sar", "edx, " + std::to_string(magic.shift));
+  o("mov", "eax, edx");
+  o("shr", "eax, 31");
+  o("add", "eax, edx");
+  if (remainder) {
+    o("imul", "eax, eax, " + std::to_string(divisor));
+    o("sub", "ecx, eax");
+    push("ecx");
+  } else {
+    push("eax");
+  }
+}
+
+void og::postfix_tos_emitter::shift(const char *mnemonic) {
+  fetch(2);
+  std::string b = pop();
+  std::string a = _cache.back();
+
+  // the shift count goes in cl
+  if (a == "ecx") {
+    o("xchg", "ecx, " + b);
+    _cache.back() = a = b;
+  } else if (b != "ecx") {
+    o("mov", "ecx, " + b);
+  }
+  o(mnemonic, a + ", cl");
+}
+
+void og::postfix_tos_emitter::branch(const char *condition, const std::string &label, bool compareWithZero) {
+  if (compareWithZero) {
+    std::string a = pop();
+    o("cmp", a + ", 0");
+  } else {
+    fetch(2);
+    std::string b = pop();
+    std::string a = pop();
+    o("cmp", a + ", " + b);
+  }
+  flush(); // pushes do not change the flags
+  o(std::string("j") + condition, "near " + label);
+}
+
+void og::postfix_tos_emitter::emit(const postfix_instruction &instruction) {
+  std::string reg;
+
+  if (instruction.op == postfix_opcode::COMMENT) {
+    postfix_buffer::replay(instruction, _pf, _os);
+    return;
+  }
+  if (_compared && compared(instruction)) return;
+
+  // a frame real, read or written in place
+  if (_framed && (instruction.op == postfix_opcode::LDDOUBLE || instruction.op == postfix_opcode::STDOUBLE)) {
+    _framed = false;
+    if (instruction.op == postfix_opcode::LDDOUBLE) {
+      load_double("qword " + frame(_constant));
+    } else {
+      store_double("qword " + frame(_constant));
+    }
+    return;
+  }
+
+  // base + k, then a load or store: [base+k]
+  if (_displaced) {
+    _displaced = false;
+    if (access(instruction, _constant)) return;
+    _displaced = true;
+  }
+  if (_immediate && instruction.op == postfix_opcode::ADD) {
+    _immediate = false;
+    fetch(1);
+    _displaced = true;
+    return;
+  }
+  if (_immediate && (instruction.op == postfix_opcode::SHTL || instruction.op == postfix_opcode::SHTRU
+      || instruction.op == postfix_opcode::SHTRS)) {
+    _immediate = false;
+    fetch(1);
+    o(instruction.op == postfix_opcode::SHTL ? "shl" : instruction.op == postfix_opcode::SHTRU ? "shr" : "sar",
+      _cache.back() + ", " + std::to_string(_constant & 31));
+    return;
+  }
+  if (_immediate && (instruction.op == postfix_opcode::DIV || instruction.op == postfix_opcode::MOD)
+      && (_constant >= 2 || _constant <= -2)) {
+    _immediate = false;
+    constant_division(_constant, instruction.op == postfix_opcode::MOD);
+    return;
+  }
+  settle();
+  if (_sse2 && real(instruction)) return;
+
+  switch (instruction.op) {
+    case postfix_opcode::INT:
+      _immediate = true;
+      _constant = instruction.ival;
+      return;
+    case postfix_opcode::ADDR:
+      reg = allocate();
+      o("mov", reg + ", " + instruction.sval);
+      push(reg);
+      return;
+    case postfix_opcode::LOCAL:
+      reg = allocate();
+      o("lea", reg + ", " + frame(instruction.ival));
+      push(reg);
+      return;
+    case postfix_opcode::LOCV:
+      reg = allocate();
+      o("mov", reg + ", dword " + frame(instruction.ival));
+      push(reg);
+      return;
+    case postfix_opcode::ADDRV:
+      reg = allocate();
+      o("mov", reg + ", dword [" + instruction.sval + "]");
+      push(reg);
+      return;
+
+    case postfix_opcode::LOCA:
+      o("mov", "dword " + frame(instruction.ival) + ", " + pop());
+      return;
+    case postfix_opcode::ADDRA:
+      o("mov", "dword [" + instruction.sval + "], " + pop());
+      return;
+    case postfix_opcode::LDINT:
+    case postfix_opcode::STINT:
+    case postfix_opcode::LDDOUBLE:
+    case postfix_opcode::STDOUBLE:
+      access(instruction, 0);
+      return;
+
+    case postfix_opcode::ADD: binary("add"); return;
+    case postfix_opcode::SUB: binary("sub"); return;
+    case postfix_opcode::MUL: binary("imul"); return;
+    case postfix_opcode::AND: binary("and"); return;
+    case postfix_opcode::OR: binary("or"); return;
+    case postfix_opcode::XOR: binary("xor"); return;
+    case postfix_opcode::SHTL: shift("shl"); return;
+    case postfix_opcode::SHTRU: shift("shr"); return;
+    case postfix_opcode::SHTRS: shift("sar"); return;
+    case postfix_opcode::DIV: division(false); return;
+    case postfix_opcode::MOD: division(true); return;
+    case postfix_opcode::NEG:
+      fetch(1);
+      o("neg", _cache.back());
+      return;
+    case postfix_opcode::NOT:
+      fetch(1);
+      o("cmp", _cache.back() + ", 0");
+      o("sete", low(_cache.back()));
+      o("movzx", _cache.back() + ", " + low(_cache.back()));
+      return;
+
+    case postfix_opcode::EQ: compare("e"); return;
+    case postfix_opcode::NE: compare("ne"); return;
+    case postfix_opcode::LT: compare("l"); return;
+    case postfix_opcode::LE: compare("le"); return;
+    case postfix_opcode::GT: compare("g"); return;
+    case postfix_opcode::GE: compare("ge"); return;
+
+    case postfix_opcode::DUP32:
+      fetch(1);
+      reg = allocate();
+      o("mov", reg + ", " + _cache.back());
+      push(reg);
+      return;
+    case postfix_opcode::SWAP32:
+      fetch(2);
+      std::swap(_cache[0], _cache[1]);
+      return;
+    case postfix_opcode::TRASH:
+      if (instruction.ival % 4 == 0) {
+        int words = instruction.ival / 4;
+        for (; words > 0 && !_cache.empty(); words--) {
+          _cache.pop_back();
+        }
+        for (; words >= 2 && !_doubles.empty(); words -= 2) {
+          _doubles.pop_back();
+        }
+        if (words > 0) o("add", "esp, " + std::to_string(4 * words));
+        return;
+      }
+      break;
+
+    case postfix_opcode::STFVAL32:
+      reg = pop();
+      if (reg != "eax") o("mov", "eax, " + reg);
+      return;
+    case postfix_opcode::LDFVAL32:
+      flush();
+      push("eax");
+      return;
+    case postfix_opcode::STFVALPAIR: {
+      fetch(2);
+      std::string lowWord = _cache[1], highWord = _cache[0]; // the top is at offset 0
+      _cache.clear();
+      place(lowWord, "eax", highWord, "edx");
+      return;
+    }
+    case postfix_opcode::LDFVALPAIR:
+      flush();
+      push("edx");
+      push("eax");
+      return;
+    case postfix_opcode::STARGS: {
+      fetch(instruction.ival);
+      std::string first = pop(), second = instruction.ival == 2 ? pop() : "";
+      flush(); // the other arguments go on the machine stack
+      if (second.empty()) {
+        if (first != "ecx") o("mov", "ecx, " + first);
+        _arguments = { "ecx" };
+      } else {
+        place(first, "ecx", second, "edx");
+        _arguments = { "ecx", "edx" };
+      }
+      return;
+    }
+    case postfix_opcode::LDARGS:
+      flush();
+      if (instruction.ival == 2) push("edx");
+      push("ecx");
+      return;
+    case postfix_opcode::ENTER:
+      if (instruction.ival == 0) {
+        // no locals: not even "sub esp, 0"
+        flush();
+        o("push", "ebp");
+        o("mov", "ebp, esp");
+        return;
+      }
+      break;
+    case postfix_opcode::LEAVE:
+      _cache.clear(); // the frame (and anything on the stack) is discarded
+      _doubles.clear();
+      break;
+
+    case postfix_opcode::JZ: branch("e", instruction.sval, true); return;
+    case postfix_opcode::JNZ: branch("ne", instruction.sval, true); return;
+    case postfix_opcode::JEQ: branch("e", instruction.sval, false); return;
+    case postfix_opcode::JNE: branch("ne", instruction.sval, false); return;
+    case postfix_opcode::JLT: branch("l", instruction.sval, false); return;
+    case postfix_opcode::JLE: branch("le", instruction.sval, false); return;
+    case postfix_opcode::JGT: branch("g", instruction.sval, false); return;
+    case postfix_opcode::JGE: branch("ge", instruction.sval, false); return;
+
+    case postfix_opcode::JTABLE:
+      reg = pop();
+      flush();
+      o("cmp", reg + ", " + std::to_string(instruction.labels.size()));
+      o("jae", "near " + instruction.sval2);
+      o("jmp", "dword [" + instruction.sval + "+" + reg + "*4]");
+      postfix_buffer::jump_table(instruction, _pf);
+      return;
+
+    default:
+      break;
+  }
+
+  // anything else works on the machine stack
+  if (instruction.op == postfix_opcode::CALL || instruction.op == postfix_opcode::JMP) _arguments.clear();
+  flush();
+  postfix_buffer::replay(instruction, _pf, _os);
+}
+
+//---------------------------------------------------------------------------
+//     REALS (SSE2)
+//---------------------------------------------------------------------------
+
+// the cached reals go to the machine stack (under the cached words, which stay)
+void og::postfix_tos_emitter::spill_doubles() {
+  if (_doubles.empty()) return;
+  o("sub", "esp, " + std::to_string(8 * _doubles.size()));
+  for (size_t ix = 0; ix < _doubles.size(); ix++) {
+    o("movsd", address("esp", 8 * (_doubles.size() - 1 - ix)) + ", " + _doubles[ix]);
+  }
+  _doubles.clear();
+}
+
+std::string og::postfix_tos_emitter::allocate_double() {
+  // xmm6 and xmm7 are scratch registers
+  if (_doubles.size() == 6) {
+    o("sub", "esp, 8");
+    o("movsd", "[esp], " + _doubles.front());
+    _doubles.erase(_doubles.begin());
+  }
+  for (int ix = 0; ix < 6; ix++) {
+    std::string reg = "xmm" + std::to_string(ix);
+    if (std::find(_doubles.begin(), _doubles.end(), reg) == _doubles.end()) return reg;
+  }
+  return ""; // cannot happen
+}
+
+// reals below the cached ones come from the machine stack (there are no cached words above them)
+void og::postfix_tos_emitter::fetch_doubles(size_t count) {
+  if (!_cache.empty()) flush();
+  while (_doubles.size() < count) {
+    std::string reg = allocate_double();
+    o("movsd", reg + ", qword [esp]");
+    o("add", "esp, 8");
+    _doubles.insert(_doubles.begin(), reg);
+  }
+}
+
+std::string og::postfix_tos_emitter::pop_double() {
+  fetch_doubles(1);
+  std::string reg = _doubles.back();
+  _doubles.pop_back();
+  return reg;
+}
+
+void og::postfix_tos_emitter::load_double(const std::string &source) {
+  if (!_cache.empty()) flush(); // the real goes above the cached words
+  std::string reg = allocate_double();
+  o("movsd", reg + ", " + source);
+  _doubles.push_back(reg);
+}
+
+void og::postfix_tos_emitter::store_double(const std::string &target) {
+  o("movsd", target + ", " + pop_double());
+}
+
+// label of a constant in rodata
+std::string og::postfix_tos_emitter::real_constant(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof bits);
+  auto it = _reals.find(bits);
+  if (it != _reals.end()) return it->second;
+
+  std::string label = "_D" + std::to_string(++_labels);
+  _pf.RODATA();
+  postfix_buffer::replay(postfix_instruction(postfix_opcode::ALIGN8), _pf, _os);
+  _pf.LABEL(label);
+  _pf.SDOUBLE(value);
+  _pf.TEXT();
+  return _reals[bits] = label;
+}
+
+bool og::postfix_tos_emitter::real(const postfix_instruction &instruction) {
+  std::string a, b, reg;
+
+  switch (instruction.op) {
+    case postfix_opcode::LOCAL:
+      _framed = true; // in case a real is read or written there
+      _constant = instruction.ival;
+      return true;
+
+    case postfix_opcode::DOUBLE:
+      if (instruction.dval == 0 && !std::signbit(instruction.dval)) {
+        if (!_cache.empty()) flush();
+        reg = allocate_double();
+        o("xorpd", reg + ", " + reg);
+        _doubles.push_back(reg);
+      } else {
+        load_double("qword [" + real_constant(instruction.dval) + "]");
+      }
+      return true;
+
+    case postfix_opcode::DADD:
+    case postfix_opcode::DSUB:
+    case postfix_opcode::DMUL:
+    case postfix_opcode::DDIV:
+      fetch_doubles(2);
+      b = pop_double();
+      a = _doubles.back();
+      o(instruction.op == postfix_opcode::DADD ? "addsd" : instruction.op == postfix_opcode::DSUB ? "subsd"
+        : instruction.op == postfix_opcode::DMUL ? "mulsd" : "divsd", a + ", " + b);
+      return true;
+    case postfix_opcode::DNEG:
+      // flip the sign bit (as fchs does, also for zero)
+      fetch_doubles(1);
+      o("pcmpeqd", "xmm7, xmm7");
+      o("psllq", "xmm7, 63");
+      o("xorpd", _doubles.back() + ", xmm7");
+      return true;
+
+    case postfix_opcode::I2D:
+      reg = pop();
+      if (!_cache.empty()) flush();
+      a = allocate_double();
+      o("cvtsi2sd", a + ", " + reg);
+      _doubles.push_back(a);
+      return true;
+    case postfix_opcode::D2I:
+      // rounds to nearest, as fistp does
+      a = pop_double();
+      reg = allocate();
+      o("cvtsd2si", reg + ", " + a);
+      push(reg);
+      return true;
+
+    case postfix_opcode::DUP64:
+      if (!_cache.empty() || _doubles.empty()) return false;
+      a = _doubles.back();
+      reg = allocate_double();
+      o("movapd", reg + ", " + a);
+      _doubles.push_back(reg);
+      return true;
+
+    case postfix_opcode::DCMP:
+      // the flags are only turned into -1, 0 or 1 if something other than a test follows
+      fetch_doubles(2);
+      b = pop_double();
+      a = pop_double();
+      flush();
+      o("ucomisd", a + ", " + b);
+      _compared = true;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+// the instruction after DCMP (and INT 0): a test of the comparison uses the flags directly
+// (unordered operands compare as less, as with fcomip)
+bool og::postfix_tos_emitter::compared(const postfix_instruction &instruction) {
+  if (!_comparedZero && instruction.op == postfix_opcode::INT && instruction.ival == 0) {
+    _comparedZero = true;
+    return true;
+  }
+
+  static const std::map<postfix_opcode, std::string> jumps = {
+    { postfix_opcode::JLT, "b" }, { postfix_opcode::JLE, "be" },
+    { postfix_opcode::JGT, "a" }, { postfix_opcode::JGE, "ae" },
+  };
+  static const std::map<postfix_opcode, std::string> tests = {
+    { postfix_opcode::LT, "b" }, { postfix_opcode::LE, "be" }, { postfix_opcode::GT, "a" },
+    { postfix_opcode::GE, "ae" }, { postfix_opcode::EQ, "e" }, { postfix_opcode::NE, "ne" },
+  };
+
+  if (_comparedZero) {
+    auto jump = jumps.find(instruction.op);
+    auto test = tests.find(instruction.op);
+    bool fused = true;
+    if (jump != jumps.end()) {
+      o("j" + jump->second, "near " + instruction.sval);
+    } else if (instruction.op == postfix_opcode::JEQ) {
+      std::string unordered = "_S" + std::to_string(++_labels);
+      o("jp", "near " + unordered);
+      o("je", "near " + instruction.sval);
+      _os << unordered << ":" << std::endl;
+    } else if (instruction.op == postfix_opcode::JNE) {
+      o("jne", "near " + instruction.sval);
+      o("jp", "near " + instruction.sval);
+    } else if (test != tests.end()) {
+      std::string reg = allocate();
+      push(reg);
+      if (instruction.op == postfix_opcode::EQ || instruction.op == postfix_opcode::NE) {
+        std::string parity = allocate();
+        o(instruction.op == postfix_opcode::EQ ? "setnp" : "setp", low(parity));
+        o("set" + test->second, low(reg));
+        o(instruction.op == postfix_opcode::EQ ? "and" : "or", low(reg) + ", " + low(parity));
+      } else {
+        o("set" + test->second, low(reg));
+      }
+      o("movzx", reg + ", " + low(reg));
+    } else {
+      fused = false;
+    }
+    if (fused) {
+      _compared = _comparedZero = false;
+      return true;
+    }
+  }
+
+  // -1, 0 or 1 (mov does not change the flags)
+  _compared = false;
+  std::string above = allocate();
+  o("mov", above + ", 0");
+  o("seta", low(above));
+  push(above);
+  std::string below = allocate();
+  o("mov", below + ", 0");
+  o("setb", low(below));
+  o("sub", above + ", " + below);
+  if (_comparedZero) {
+    _comparedZero = false;
+    _immediate = true;
+    _constant = 0;
+  }
+  return false;
+}
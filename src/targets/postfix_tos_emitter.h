@@ -0,0 +1,102 @@
+#ifndef __OG_TARGETS_POSTFIX_TOS_EMITTER_H__
+#define __OG_TARGETS_POSTFIX_TOS_EMITTER_H__
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cdk/emitters/basic_postfix_emitter.h>
+#include "targets/postfix_buffer.h"
+#include "targets/options.h"
+
+namespace og {
+
+  /**
+   * Writes postfix code to an ix86 postfix emitter, keeping the top (at most
+   * two) values of the stack in registers (eax, ecx, edx) instead of memory.
+   * Simple stack operations are written directly; the cache is spilled to the
+   * machine stack at calls, labels and jumps, and before any other instruction,
+   * which is then left to the emitter.
+   *
+   * Constants added to an address ("INT k ADD", as in tuple components) are
+   * held back and folded into the addressing mode of the load or store that
+   * follows, so each component costs a single move. Constant shift counts
+   * become immediates, and divisions by constants become multiplications.
+   *
+   * With --sse2, reals are computed with SSE2 scalar instructions instead of
+   * the x87 stack: the top reals are kept in xmm0-xmm5 (below any cached
+   * words), frame reals are read and written in place, and a comparison
+   * (DCMP INT 0 and a test) becomes a ucomisd and a jump. Reals are still
+   * passed and returned as the emitter does (on the stack and in st0).
+   */
+  class postfix_tos_emitter {
+    cdk::basic_postfix_emitter &_pf;
+    std::ostream &_os;
+    std::vector<std::string> _cache; // registers holding the top of the stack (last is the top)
+    std::vector<std::string> _arguments; // set by STARGS, kept until the call (or tail jump)
+    bool _immediate = false;         // INT _constant not written yet
+    bool _displaced = false;         // _constant not yet added to the top of the cache
+    int _constant = 0;
+
+    bool _sse2;
+    std::vector<std::string> _doubles; // xmm registers holding the reals under the cached words (last is the top)
+    bool _framed = false;       // LOCAL _constant not written yet
+    bool _compared = false;     // flags set by DCMP, its result not written yet
+    bool _comparedZero = false; // ...and then compared with INT 0
+    std::map<uint64_t, std::string> _reals; // constants (bit patterns) already in rodata
+    int _labels = 0;
+
+  public:
+    postfix_tos_emitter(cdk::basic_postfix_emitter &pf, std::ostream &os) :
+        _pf(pf), _os(os), _sse2(options::get().sse2()) {
+    }
+
+  public:
+    void emit(const postfix_instruction &instruction);
+
+    void emit(const postfix_buffer &buffer) {
+      for (auto &instruction : buffer.code()) {
+        emit(instruction);
+      }
+      flush();
+    }
+
+  private:
+    void o(const std::string &mnemonic, const std::string &operands = "") {
+      _os << "\t" << mnemonic << "\t" << operands << std::endl;
+    }
+
+    void flush();
+    void settle();
+    bool access(const postfix_instruction &instruction, int displacement);
+    void fetch(size_t count);
+    bool taken(const std::string &reg) const;
+    std::string allocate();
+    std::string pop();
+    void push(const std::string &reg) {
+      _cache.push_back(reg);
+    }
+    void place(const std::string &a, const std::string &ra, const std::string &b, const std::string &rb);
+
+    void binary(const char *mnemonic);
+    void compare(const char *condition);
+    void division(bool remainder);
+    void constant_division(int divisor, bool remainder);
+    void shift(const char *mnemonic);
+    void branch(const char *condition, const std::string &label, bool compareWithZero);
+
+    void spill_doubles();
+    void fetch_doubles(size_t count);
+    std::string allocate_double();
+    std::string pop_double();
+    void load_double(const std::string &source);
+    void store_double(const std::string &target);
+    std::string real_constant(double value);
+    bool real(const postfix_instruction &instruction);
+    bool compared(const postfix_instruction &instruction);
+  };
+
+} // og
+
+#endif
@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <functional>
 #include "targets/type_checker.h"
 #include "targets/frame_size_calculator.h"
+#include "targets/loop_invariant_finder.h"
+#include "targets/options.h"
 #include "targets/postfix_writer.h"
 #include "ast/all.h"  // all.h is automatically generated
 
@@ -31,11 +34,13 @@ void og::postfix_writer::do_data_node(cdk::data_node * const node, int lvl) {
   // EMPTY
 }
 void og::postfix_writer::do_not_node(cdk::not_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
   node->argument()->accept(this, lvl + 2);
   _pf.NOT();
 }
 void og::postfix_writer::do_and_node(cdk::and_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
   int lbl = ++_lbl;
   node->left()->accept(this, lvl + 2);
@@ -46,6 +51,7 @@ void og::postfix_writer::do_and_node(cdk::and_node * const node, int lvl) {
   _pf.LABEL(mklbl(lbl));
 }
 void og::postfix_writer::do_or_node(cdk::or_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
   int lbl = ++_lbl;
   node->left()->accept(this, lvl + 2);
@@ -59,6 +65,13 @@ void og::postfix_writer::do_or_node(cdk::or_node * const node, int lvl) {
 //---------------------------------------------------------------------------
 
 void og::postfix_writer::do_sequence_node(cdk::sequence_node * const node, int lvl) {
+  if (!_function) {
+    // the module's own functions (see choose_return_registers)
+    for (size_t i = 0; i < node->size(); i++) {
+      auto definition = dynamic_cast<og::function_definition_node*>(node->node(i));
+      if (definition && definition->qualifier() != tPUBLIC) _privateFunctions.insert(definition->identifier());
+    }
+  }
   for (size_t i = 0; i < node->size(); i++) {
     node->node(i)->accept(this, lvl);
   }
@@ -107,7 +120,13 @@ void og::postfix_writer::do_string_node(cdk::string_node * const node, int lvl)
 //---------------------------------------------------------------------------
 
 void og::postfix_writer::do_neg_node(cdk::neg_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
+  auto literal = dynamic_cast<cdk::integer_node*>(node->argument());
+  if (literal && node->is_typed(cdk::TYPE_INT)) {
+    _pf.INT(-(uint32_t)literal->value()); // a negative constant (as a divisor, say)
+    return;
+  }
   node->argument()->accept(this, lvl);
   if (node->is_typed(cdk::TYPE_DOUBLE)) {
     _pf.DNEG();
@@ -149,8 +168,82 @@ void og::postfix_writer::processIDComparison(cdk::binary_operation_node *const n
   }
 }
 
+/**
+ * Compile a condition in branch position: jump to lbl when it evaluates to
+ * jumpIfTrue. Comparisons jump directly and logical operators become jump
+ * chains, so no boolean value is produced.
+ */
+void og::postfix_writer::branch(cdk::expression_node *const condition, int lbl, bool jumpIfTrue, int lvl) {
+  if (load_hoisted(condition)) {
+    if (jumpIfTrue) _pf.JNZ(mklbl(lbl)); else _pf.JZ(mklbl(lbl));
+    return;
+  }
+
+  auto tuple = dynamic_cast<og::tuple_node*>(condition);
+  if (tuple && tuple->size() == 1) {
+    branch(tuple->element(0), lbl, jumpIfTrue, lvl);
+    return;
+  }
+
+  if (auto node = dynamic_cast<cdk::not_node*>(condition)) {
+    branch(node->argument(), lbl, !jumpIfTrue, lvl);
+    return;
+  }
+
+  if (auto node = dynamic_cast<cdk::and_node*>(condition)) {
+    if (jumpIfTrue) {
+      int skip = ++_lbl;
+      branch(node->left(), skip, false, lvl);
+      branch(node->right(), lbl, true, lvl);
+      _pf.LABEL(mklbl(skip));
+    } else {
+      branch(node->left(), lbl, false, lvl);
+      branch(node->right(), lbl, false, lvl);
+    }
+    return;
+  }
+
+  if (auto node = dynamic_cast<cdk::or_node*>(condition)) {
+    if (jumpIfTrue) {
+      branch(node->left(), lbl, true, lvl);
+      branch(node->right(), lbl, true, lvl);
+    } else {
+      int skip = ++_lbl;
+      branch(node->left(), skip, true, lvl);
+      branch(node->right(), lbl, false, lvl);
+      _pf.LABEL(mklbl(skip));
+    }
+    return;
+  }
+
+  // comparisons (doubles compare the DCMP result with 0)
+  std::string target = mklbl(lbl);
+  if (auto node = dynamic_cast<cdk::lt_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JLT(target); else _pf.JGE(target);
+  } else if (auto node = dynamic_cast<cdk::le_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JLE(target); else _pf.JGT(target);
+  } else if (auto node = dynamic_cast<cdk::ge_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JGE(target); else _pf.JLT(target);
+  } else if (auto node = dynamic_cast<cdk::gt_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JGT(target); else _pf.JLE(target);
+  } else if (auto node = dynamic_cast<cdk::eq_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JEQ(target); else _pf.JNE(target);
+  } else if (auto node = dynamic_cast<cdk::ne_node*>(condition)) {
+    processIDComparison(node, lvl);
+    if (jumpIfTrue) _pf.JNE(target); else _pf.JEQ(target);
+  } else {
+    condition->accept(this, lvl);
+    if (jumpIfTrue) _pf.JNZ(target); else _pf.JZ(target);
+  }
+}
 
 void og::postfix_writer::do_add_node(cdk::add_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
   node->left()->accept(this, lvl);
   if (node->is_typed(cdk::TYPE_DOUBLE) && node->left()->is_typed(cdk::TYPE_INT)) {
@@ -177,6 +270,7 @@ void og::postfix_writer::do_add_node(cdk::add_node * const node, int lvl) {
   }
 }
 void og::postfix_writer::do_sub_node(cdk::sub_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
 
   node->left()->accept(this, lvl);
@@ -200,6 +294,7 @@ void og::postfix_writer::do_sub_node(cdk::sub_node * const node, int lvl) {
   }
 }
 void og::postfix_writer::do_mul_node(cdk::mul_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDBinaryExpression(node, lvl);
   if (node->is_typed(cdk::TYPE_INT)) {
     _pf.MUL();
@@ -208,6 +303,7 @@ void og::postfix_writer::do_mul_node(cdk::mul_node * const node, int lvl) {
   }
 }
 void og::postfix_writer::do_div_node(cdk::div_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDBinaryExpression(node, lvl);
   if (node->is_typed(cdk::TYPE_INT)) {
     _pf.DIV();
@@ -216,32 +312,39 @@ void og::postfix_writer::do_div_node(cdk::div_node * const node, int lvl) {
   }
 }
 void og::postfix_writer::do_mod_node(cdk::mod_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
   node->left()->accept(this, lvl);
   node->right()->accept(this, lvl);
   _pf.MOD();
 }
 void og::postfix_writer::do_lt_node(cdk::lt_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.LT();
 }
 void og::postfix_writer::do_le_node(cdk::le_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.LE();
 }
 void og::postfix_writer::do_ge_node(cdk::ge_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.GE();
 }
 void og::postfix_writer::do_gt_node(cdk::gt_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.GT();
 }
 void og::postfix_writer::do_ne_node(cdk::ne_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.NE();
 }
 void og::postfix_writer::do_eq_node(cdk::eq_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   processIDComparison(node, lvl);
   _pf.EQ();
 }
@@ -290,7 +393,20 @@ void og::postfix_writer::do_variable_node(cdk::variable_node * const node, int l
 }
 
 void og::postfix_writer::do_pointer_index_node(og::pointer_index_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
+
+  auto induction = _inductionAccesses.find(node);
+  if (induction != _inductionAccesses.end()) {
+    _pf.LOCAL(induction->second.first);
+    _pf.LDINT();
+    if (induction->second.second) {
+      _pf.INT(induction->second.second);
+      _pf.ADD();
+    }
+    return;
+  }
+
   node->base()->accept(this, lvl);
   node->index()->accept(this, lvl);
   auto reftype = cdk::reference_type_cast(node->base()->type());
@@ -345,35 +461,112 @@ the node will be visited, and, if a struct base address is pushed to the stack i
 FP-tempOffset should be unshared temporary storage (assigned by og::frame_size_calculator)
 */
 void og::postfix_writer::load(cdk::typed_node *const lval_or_expr, int lvl, int tempOffset) {
+  if (evaluate(lval_or_expr, lvl, tempOffset)) {
+    load_from_base(lval_or_expr->type(), [this, tempOffset]() { _pf.LOCV(tempOffset); });
+  }
+}
+
+/*
+first half of load: visits the node and, if a struct base address was pushed instead of its value, moves
+it to FP-tempOffset and returns true (the tuple itself is not loaded)
+*/
+bool og::postfix_writer::evaluate(cdk::typed_node *const lval_or_expr, int lvl, int tempOffset) {
   bool old = _needTupleAddr;
   _needTupleAddr = false;
   _evaledTupleAddr = true; // assume the worst
   lval_or_expr->accept(this, lvl);
   _needTupleAddr = old;
 
-  if (lval_or_expr->is_typed(cdk::TYPE_STRUCT) && _evaledTupleAddr) {
-    int tuple_base_addr_location = tempOffset;
-    if (tuple_base_addr_location == 0) {
-      std::cerr << "ICE(postfix_writer): Node was not assigned exclusive temporary storage for load\n";
-      exit(1);
+  bool address = lval_or_expr->is_typed(cdk::TYPE_STRUCT) && _evaledTupleAddr;
+  _evaledTupleAddr = false;
+  if (!address) return false;
+
+  if (tempOffset == 0) {
+    std::cerr << "ICE(postfix_writer): Node was not assigned exclusive temporary storage for load\n";
+    exit(1);
+  }
+  _pf.LOCAL(tempOffset);
+  _pf.STINT();
+  return true;
+}
+
+// whether a value of type rvalType is stored in memory exactly as one of type lvalType (no conversions)
+static bool same_layout(std::shared_ptr<cdk::basic_type> lvalType, std::shared_ptr<cdk::basic_type> rvalType) {
+  if (lvalType->name() != cdk::TYPE_STRUCT || rvalType->name() != cdk::TYPE_STRUCT) {
+    return lvalType->name() != cdk::TYPE_STRUCT && rvalType->name() != cdk::TYPE_STRUCT
+        && lvalType->size() == rvalType->size();
+  }
+
+  auto lvalStructType = cdk::structured_type_cast(lvalType);
+  auto rvalStructType = cdk::structured_type_cast(rvalType);
+  if (lvalStructType->length() != rvalStructType->length()) return false;
+  for (size_t ix = 0; ix < lvalStructType->length(); ix++) {
+    if (!same_layout(lvalStructType->component(ix), rvalStructType->component(ix))) return false;
+  }
+  return true;
+}
+
+/*
+stores a value into the storage at the address emitted by baseSupplier (as store does)
+tuples that evaluate to an address and need no conversions are copied word by word, memory to memory,
+instead of being loaded onto the stack first
+*/
+void og::postfix_writer::initialize(std::shared_ptr<cdk::basic_type> lvalType, cdk::typed_node *const value, int lvl,
+                                    int tempOffset, std::function<void()> baseSupplier) {
+  bool copyable = value->is_typed(cdk::TYPE_STRUCT) && same_layout(lvalType, value->type());
+
+  // tuple variables are copied from where they are (reading them has no side effects)
+  cdk::typed_node *variable = value;
+  while (dynamic_cast<og::tuple_node*>(variable) && dynamic_cast<og::tuple_node*>(variable)->size() == 1) {
+    variable = dynamic_cast<og::tuple_node*>(variable)->element(0);
+  }
+  auto rvalue = dynamic_cast<cdk::rvalue_node*>(variable);
+  if (copyable && rvalue && dynamic_cast<cdk::variable_node*>(rvalue->lvalue())) {
+    copy(lvalType->size(), [this, rvalue, lvl]() { rvalue->lvalue()->accept(this, lvl); }, baseSupplier);
+    return;
+  }
+
+  if (evaluate(value, lvl, tempOffset)) {
+    if (copyable) {
+      copy(lvalType->size(), [this, tempOffset]() { _pf.LOCV(tempOffset); }, baseSupplier);
+      return;
     }
+    load_from_base(value->type(), [this, tempOffset]() { _pf.LOCV(tempOffset); });
+  }
+  store(lvalType, value->type(), baseSupplier);
+}
 
-    _pf.LOCAL(tuple_base_addr_location);
+// copy size bytes, a word at a time, between the addresses emitted by the suppliers
+void og::postfix_writer::copy(size_t size, std::function<void()> sourceSupplier, std::function<void()> baseSupplier) {
+  for (size_t offset = 0; offset < size; offset += 4) {
+    sourceSupplier();
+    if (offset) {
+      _pf.INT(offset);
+      _pf.ADD();
+    }
+    _pf.LDINT();
+    baseSupplier();
+    if (offset) {
+      _pf.INT(offset);
+      _pf.ADD();
+    }
     _pf.STINT();
-
-    load_from_base(lval_or_expr->type(), [this, tuple_base_addr_location]() { _pf.LOCV(tuple_base_addr_location); });
   }
-  _evaledTupleAddr = false;
 }
 
 void og::postfix_writer::do_rvalue_node(cdk::rvalue_node * const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
-  os() << ";; rvalue_node start\n";
+  _pf.COMMENT("rvalue_node start");
   if (node->lvalue()->is_typed(cdk::TYPE_STRUCT)) {
     if (_needTupleAddr) {
       // delay getting value
       node->lvalue()->accept(this, lvl);
       _evaledTupleAddr = true;
+    } else if (dynamic_cast<cdk::variable_node*>(node->lvalue())) {
+      // tuple variables are read component by component, in place: their address is not kept anywhere
+      load_from_base(node->type(), [node, this, lvl]() { node->lvalue()->accept(this, lvl); });
+      _evaledTupleAddr = false;
     } else {
       load(node->lvalue(), lvl, tempOffsetForNode(node));
       _evaledTupleAddr = false;
@@ -381,7 +574,7 @@ void og::postfix_writer::do_rvalue_node(cdk::rvalue_node * const node, int lvl)
   } else {
     load_from_base(node->type(), [node, this, lvl]() { node->lvalue()->accept(this, lvl); });
   }
-  os() << ";; rvalue_node end\n";
+  _pf.COMMENT("rvalue_node end");
 }
 
 void og::postfix_writer::do_assignment_node(cdk::assignment_node * const node, int lvl) {
@@ -411,15 +604,53 @@ void og::postfix_writer::do_function_declaration_node(og::function_declaration_n
   auto name = fix_function_name(node->identifier());
 
   _extern_functions.insert(name);
+  choose_return_registers(_symtab.find(node->identifier()));
+  choose_argument_registers(_symtab.find(node->identifier()));
+}
+
+/**
+ * Functions private to the module return tuples of one or two words in
+ * registers, as scalars are (eax, then edx for the second word), instead of
+ * storing them through a hidden pointer to a temporary of the caller. The
+ * public functions keep the usual convention.
+ */
+void og::postfix_writer::choose_return_registers(std::shared_ptr<og::symbol> function) {
+  if (!_privateFunctions.count(function->name()) || !function->is_typed(cdk::TYPE_STRUCT)) return;
+
+  auto type = cdk::structured_type_cast(function->type());
+  if (type->size() > 8) return;
+  for (auto component : type->components()) {
+    if (component->size() != 4) return;
+  }
+  _registerReturns.insert(function->name());
+}
+
+/**
+ * Private functions also get their first arguments in registers (ecx, then
+ * edx), as long as those are words: the callee keeps them in frame slots of
+ * its own, below its locals. Functions that take a hidden pointer to their
+ * result, and those whose arguments are wide enough to be passed by
+ * reference (see by_reference), keep all of their arguments on the stack.
+ */
+void og::postfix_writer::choose_argument_registers(std::shared_ptr<og::symbol> function) {
+  if (!_privateFunctions.count(function->name()) || !function->argsType()) return;
+  if (function->is_typed(cdk::TYPE_STRUCT) && !_registerReturns.count(function->name())) return;
+  if (function->argsType()->size() >= 16) return;
+
+  int words = 0;
+  for (auto component : function->argsType()->components()) {
+    if (component->size() != 4 || words == 2) break;
+    words++;
+  }
+  if (words) _registerArguments[function->name()] = words;
 }
 
 std::map<const cdk::basic_node*, int> calculate_unshared_temp_offsets(const og::frame_size_calculator &fsc) {
   std::map<const cdk::basic_node*, int> offsetTab;
 
-  int offset = - fsc.localsize() - fsc.calltempsize() - fsc.returntempsize();
+  int top = - fsc.localsize() - fsc.calltempsize() - fsc.returntempsize();
   for (auto& [node, tempsz] : fsc.unsharedTempSizeTab()) {
-    offset -= tempsz;
-    offsetTab[node] = offset;
+    offsetTab[node] = top - fsc.tempSlots().at(node) - tempsz;
   }
 
   return offsetTab;
@@ -435,8 +666,10 @@ void og::postfix_writer::do_function_definition_node(og::function_definition_nod
   auto name = fix_function_name(node->identifier());
   _extern_functions.erase(name);
 
+  choose_return_registers(sym);
+  choose_argument_registers(sym);
   _offset = 8;
-  if (node->is_typed(cdk::TYPE_STRUCT)) {
+  if (node->is_typed(cdk::TYPE_STRUCT) && !_registerReturns.count(node->identifier())) {
     // account for hidden first argument (return write pointer)
     _offset += 4;
   }
@@ -459,21 +692,77 @@ void og::postfix_writer::do_function_definition_node(og::function_definition_nod
   }
   _pf.LABEL(name);
 
-  frame_size_calculator fsc(_compiler, _function, _symtab);
+  // recursive calls count as pure while the function itself is being checked
+  _pureFunctions.insert(node->identifier());
+  loop_invariant_finder finder(_compiler, _symtab, _pureFunctions);
+  finder.scan(node);
+  if (!finder.pure()) {
+    _pureFunctions.erase(node->identifier());
+  }
+
+  frame_size_calculator fsc(_compiler, _function, _symtab, _pureFunctions, _registerReturns, _referenceArguments,
+                            finder.escaped());
   node->accept(&fsc, lvl);
   _callTempOffset = - fsc.localsize() - fsc.calltempsize();
   if (fsc.returntempsize())
     _returnTempOffset = _callTempOffset - fsc.returntempsize();
   _unsharedTempOffsetTab = calculate_unshared_temp_offsets(fsc);
-
-  _pf.ENTER(fsc.localsize() + fsc.tempsize());
+  if (_compiler->debug() && fsc.unpackedTempSize()) {
+    size_t packed = fsc.tempsize() - fsc.calltempsize() - fsc.returntempsize();
+    std::cerr << "frame: " << node->identifier() << ": temporaries " << fsc.unpackedTempSize() << " -> " << packed
+              << " bytes (" << fsc.unpackedTempSize() - packed << " saved)" << std::endl;
+  }
+  _loopInvariants = fsc.loopInvariants();
+  _loopInductions = fsc.loopInductions();
+  _loopCounts = fsc.loopCounts();
+  _frameReusable = finder.escaped().empty() && !finder.allocates();
+  _entry.clear();
+
+  _enter = _pf.code().size();
+  _framesize = fsc.localsize() + fsc.tempsize();
+  _inlineFramesize = 0;
+  _argumentHomes.clear();
+  if (int words = register_words(node->identifier())) {
+    // the arguments that stay on the stack move down
+    int ix = 0;
+    for (auto arg : node->arguments()->nodes()) {
+      auto symbol = _symtab.find(static_cast<og::variable_declaration_node*>(arg)->identifiers()[0]);
+      if (ix++ < words) {
+        _framesize += 4;
+        _argumentHomes.push_back(-_framesize);
+        symbol->set_offset(-_framesize);
+      } else {
+        symbol->set_offset(symbol->offset() - 4 * words);
+      }
+    }
+  }
+  _accumulate = accumulation(finder.returns(), finder.pure());
+  _accumulator = 0;
+  if (_accumulate != postfix_opcode::NOP) {
+    _framesize += 4;
+    _accumulator = -_framesize;
+  }
+  _pf.ENTER(_framesize);
+  if (!_argumentHomes.empty()) {
+    _pf.LDARGS(_argumentHomes.size());
+    for (int home : _argumentHomes) {
+      _pf.LOCAL(home);
+      _pf.STINT();
+    }
+  }
+  if (_accumulator) {
+    _pf.INT(_accumulate == postfix_opcode::ADD ? 0 : 1);
+    _pf.LOCAL(_accumulator);
+    _pf.STINT();
+  }
+  _body = _pf.code().size();
 
   _inFunctionBody = true;
 
   _offset = 0;
-  os() << "        ;; before body " << std::endl;
+  _pf.COMMENT("before body");
   node->block()->accept(this, lvl);
-  os() << "        ;; after body " << std::endl;
+  _pf.COMMENT("after body");
   _inFunctionBody = false;
   _symtab.pop(); //arguments
   // make sure that voids are returned from
@@ -481,41 +770,59 @@ void og::postfix_writer::do_function_definition_node(og::function_definition_nod
     _pf.LEAVE();
     _pf.RET();
   }
+  // room for the inlined calls goes below everything else
+  _pf.code()[_enter].ival += _inlineFramesize;
+  if (!_entry.empty()) {
+    _pf.code().insert(_pf.code().begin() + _body, postfix_instruction(postfix_opcode::LABEL, 0, 0, _entry));
+  }
+  std::vector<postfix_instruction> body(_pf.code().begin() + _enter + 1, _pf.code().end());
+  if (!node->is_typed(cdk::TYPE_STRUCT) && name != "_main" && inlinable(body)) {
+    _inlinable[node->identifier()] = { body, _pf.code()[_enter].ival };
+  } else if (by_reference(node, finder)) {
+    pass_by_reference(node);
+  }
+
   _function = nullptr;
+  _accumulator = 0;
+  _argumentHomes.clear();
   _callTempOffset = 0;
   _returnTempOffset = 0;
   _unsharedTempOffsetTab.clear();
+  _loopInvariants.clear();
+  _loopInductions.clear();
+  _loopCounts.clear();
 }
 
 //---------------------------------------------------------------------------
 
 void og::postfix_writer::do_function_call_node(og::function_call_node *const node, int lvl) {
+  if (load_hoisted(node)) return;
   ASSERT_SAFE_EXPRESSIONS;
 
   auto name = fix_function_name(node->identifier());
   std::shared_ptr<og::symbol> symbol = _symtab.find(node->identifier());
 
-  size_t argsSize = 0;
-  auto argTypes = symbol->argsType()->components();
-
   bool return_struct = node->is_typed(cdk::TYPE_STRUCT);
+  bool registers = return_struct && _registerReturns.count(node->identifier());
+  _called.insert(node->identifier());
 
-  if (node->arguments()) {
-    for (int ax = node->arguments()->size(); ax > 0; ax--) {
-      cdk::expression_node * arg = node->arguments()->element(ax - 1);
-      // convert ints to doubles in arguments
-      arg->accept(this, lvl + 2);
-      if (arg->is_typed(cdk::TYPE_INT) && argTypes[ax - 1]->name() == cdk::TYPE_DOUBLE) {
-        _pf.I2D();
-      }
-    }
-    argsSize += symbol->argsType()->size();
+  size_t argsSize = _referenceArguments.count(node->identifier()) ? reference_arguments(node, symbol, lvl)
+                                                                   : push_arguments(node, symbol, lvl);
+
+  auto inlined = _inlinable.find(node->identifier());
+  if (inlined != _inlinable.end()) {
+    inline_call(inlined->second, symbol, argsSize);
+    return;
   }
 
-  if (return_struct) {
+  if (return_struct && !registers) {
     argsSize += 4;
     _pf.LOCAL(_callTempOffset);
   }
+  if (int words = register_words(node->identifier())) {
+    _pf.STARGS(words);
+    argsSize -= 4 * words;
+  }
   _pf.CALL(name);
   if (argsSize != 0) {
     _pf.TRASH(argsSize);
@@ -527,6 +834,17 @@ void og::postfix_writer::do_function_call_node(og::function_call_node *const nod
     _pf.LDFVAL64();
   } else if (symbol->is_typed(cdk::TYPE_VOID)) {
     // EMPTY
+  } else if (registers) {
+    if (symbol->type()->size() == 8) {
+      _pf.LDFVALPAIR();
+    } else {
+      _pf.LDFVAL32();
+    }
+    if (_needTupleAddr) {
+      store(symbol->type(), symbol->type(), [this]() { _pf.LOCAL(_callTempOffset); });
+      _pf.LOCAL(_callTempOffset);
+    }
+    _evaledTupleAddr = _needTupleAddr;
   } else if (return_struct) {
     _pf.LOCAL(_callTempOffset);
     _evaledTupleAddr = true;
@@ -536,6 +854,252 @@ void og::postfix_writer::do_function_call_node(og::function_call_node *const nod
   }
 }
 
+/**
+ * Evaluate a call's arguments onto the stack, first on top. Returns their size.
+ * A tuple spread over the arguments is pushed a component at a time, from
+ * the last one, so that its first component is the first argument.
+ */
+size_t og::postfix_writer::push_arguments(og::function_call_node *const node, std::shared_ptr<og::symbol> function, int lvl) {
+  if (!node->arguments()) return 0;
+
+  auto argTypes = function->argsType()->components();
+  cdk::expression_node *tuple = node->arguments()->element(0);
+  if (node->arguments()->size() == 1 && tuple->is_typed(cdk::TYPE_STRUCT)) {
+    std::function<void()> base;
+    auto rvalue = dynamic_cast<cdk::rvalue_node*>(tuple);
+    if (rvalue && dynamic_cast<cdk::variable_node*>(rvalue->lvalue())) {
+      base = [this, rvalue, lvl]() { rvalue->lvalue()->accept(this, lvl); }; // read in place
+    } else {
+      int tempOffset = tempOffsetForNode(node);
+      bool old = _needTupleAddr;
+      _needTupleAddr = true;
+      tuple->accept(this, lvl + 2);
+      _needTupleAddr = old;
+      _evaledTupleAddr = false;
+      _pf.LOCAL(tempOffset);
+      _pf.STINT();
+      base = [this, tempOffset]() { _pf.LOCV(tempOffset); };
+    }
+
+    auto type = cdk::structured_type_cast(tuple->type());
+    int offset = 0; // the last component is at the tuple's address
+    for (size_t ix = type->length(); ix-- > 0;) {
+      load_from_base(type->component(ix), base, offset);
+      if (type->component(ix)->name() == cdk::TYPE_INT && argTypes[ix]->name() == cdk::TYPE_DOUBLE) {
+        _pf.I2D();
+      }
+      offset += type->component(ix)->size();
+    }
+    return function->argsType()->size();
+  }
+
+  for (int ax = node->arguments()->size(); ax > 0; ax--) {
+    cdk::expression_node * arg = node->arguments()->element(ax - 1);
+    // convert ints to doubles in arguments
+    arg->accept(this, lvl + 2);
+    if (arg->is_typed(cdk::TYPE_INT) && argTypes[ax - 1]->name() == cdk::TYPE_DOUBLE) {
+      _pf.I2D();
+    }
+  }
+  return function->argsType()->size();
+}
+
+/**
+ * Whether a private function (that is not inlined) gets a pointer to its
+ * arguments, laid out as a tuple, instead of a copy of them: callers that
+ * spread a local tuple over the arguments then pass its address, whatever
+ * its width. Only wide argument lists (four words or more) are passed this
+ * way, to functions that leave their arguments unchanged and cannot change
+ * the caller's tuple (no stores through pointers, no impure calls).
+ *
+ * The choice is made once the body is written: the function must not have
+ * been called yet (not even by itself), nor reuse its arguments' slots for
+ * tail calls.
+ */
+bool og::postfix_writer::by_reference(og::function_definition_node *const node, loop_invariant_finder &finder) {
+  if (!_privateFunctions.count(node->identifier()) || _called.count(node->identifier()) || !node->arguments()) return false;
+  if (_function->argsType()->size() < 16 || !_entry.empty() || _accumulator) return false;
+
+  auto &code = _pf.code();
+  for (size_t ix = _enter; ix + 1 < code.size(); ix++) {
+    if (code[ix].op == postfix_opcode::LEAVE && code[ix + 1].op != postfix_opcode::RET) return false;
+  }
+
+  std::vector<std::string> names;
+  for (auto arg : node->arguments()->nodes()) {
+    auto &ids = static_cast<og::variable_declaration_node*>(arg)->identifiers();
+    names.insert(names.end(), ids.begin(), ids.end());
+  }
+  return finder.preserves(names);
+}
+
+/** Rewrite the current function's accesses to its arguments to go through the pointer to them (see by_reference). */
+void og::postfix_writer::pass_by_reference(og::function_definition_node *const node) {
+  int pointer = node->is_typed(cdk::TYPE_STRUCT) && !_registerReturns.count(node->identifier()) ? 12 : 8;
+
+  // frame offset of each argument -> its offset in the tuple (the first one is at the highest address)
+  std::map<int, int> positions;
+  int offset = pointer, position = _function->argsType()->size();
+  for (auto component : _function->argsType()->components()) {
+    position -= component->size();
+    positions[offset] = position;
+    offset += component->size();
+  }
+
+  std::vector<postfix_instruction> code(_pf.code().begin(), _pf.code().begin() + _enter + 1);
+  for (size_t ix = _enter + 1; ix < _pf.code().size(); ix++) {
+    auto &instruction = _pf.code()[ix];
+    auto argument = positions.find(instruction.ival);
+    if (instruction.op != postfix_opcode::LOCAL || argument == positions.end()) {
+      code.push_back(instruction);
+      continue;
+    }
+    code.push_back(postfix_instruction(postfix_opcode::LOCV, pointer));
+    if (argument->second) {
+      code.push_back(postfix_instruction(postfix_opcode::INT, argument->second));
+      code.push_back(postfix_instruction(postfix_opcode::ADD));
+    }
+  }
+  _pf.code() = code;
+  _referenceArguments.insert(node->identifier());
+}
+
+/**
+ * Push the address of a call's arguments, laid out as a tuple (see
+ * by_reference). Arguments that do not come from a local tuple are first
+ * stored in a temporary. Returns the size of what was pushed.
+ */
+size_t og::postfix_writer::reference_arguments(og::function_call_node *const node, std::shared_ptr<og::symbol> function,
+                                               int lvl) {
+  auto type = function->argsType();
+  int block = tempOffsetForNode(node->arguments());
+  auto blockSupplier = [this, block]() { _pf.LOCAL(block); };
+
+  cdk::expression_node *tuple = node->arguments()->element(0);
+  if (node->arguments()->size() == 1 && tuple->is_typed(cdk::TYPE_STRUCT)) {
+    auto rvalue = dynamic_cast<cdk::rvalue_node*>(tuple);
+    auto variable = rvalue ? dynamic_cast<cdk::variable_node*>(rvalue->lvalue()) : nullptr;
+    if (variable && !_symtab.find(variable->name())->global() && same_layout(type, tuple->type())) {
+      variable->accept(this, lvl);
+      return 4;
+    }
+    initialize(type, tuple, lvl, tempOffsetForNode(node), blockSupplier);
+  } else {
+    // the first argument goes at the highest address, as a tuple's first component
+    int offset = 0;
+    for (int ax = node->arguments()->size(); ax > 0; ax--) {
+      cdk::expression_node *arg = node->arguments()->element(ax - 1);
+      arg->accept(this, lvl + 2);
+      store(type->component(ax - 1), arg->type(), blockSupplier, offset);
+      offset += type->component(ax - 1)->size();
+    }
+  }
+  blockSupplier();
+  return 4;
+}
+
+/**
+ * Whether a function's code is worth copying into its callers: it must be
+ * short, and only use the stack and frame in ways that survive the copy
+ * (stack allocations would only be released when the caller returns).
+ */
+bool og::postfix_writer::inlinable(const std::vector<postfix_instruction> &code) {
+  static const size_t budget = 40; // postfix instructions, besides the call sequence it replaces
+
+  size_t size = 0;
+  for (size_t ix = 0; ix < code.size(); ix++) {
+    auto &instruction = code[ix];
+    if (instruction.op == postfix_opcode::ALLOC) return false;
+    if (instruction.op == postfix_opcode::JTABLE) return false; // its labels are not renamed
+    // tail calls to other functions (LEAVE JMP) need the actual frame
+    if (instruction.op == postfix_opcode::LEAVE && (ix + 1 == code.size() || code[ix + 1].op != postfix_opcode::RET)) {
+      return false;
+    }
+    if (instruction.op != postfix_opcode::COMMENT) size++;
+  }
+  return size <= budget;
+}
+
+/**
+ * Copy an inlined function's code in place of a call (the arguments are on
+ * the stack). Its frame is moved below the caller's: arguments first, then
+ * the return value and the callee's own frame. Returns store the value and
+ * jump to the end, where it is loaded, as after an actual call. Arguments
+ * that the function gets in registers are used in their stack slots.
+ */
+void og::postfix_writer::inline_call(const inline_body &body, std::shared_ptr<og::symbol> function, int argsSize) {
+  int args = -_framesize - argsSize; // callee offset 8 + k
+  int result = args - 8;             // callee offset -k is at result - k
+  _inlineFramesize = std::max(_inlineFramesize, argsSize + 8 + body.framesize);
+
+  _pf.COMMENT("inlined " + function->name());
+  for (int ix = 0; ix < argsSize; ix += 4) {
+    _pf.LOCAL(args + ix);
+    _pf.STINT();
+  }
+
+  std::map<std::string, std::string> labels;
+  for (auto &instruction : body.code) {
+    if (instruction.op == postfix_opcode::LABEL) labels[instruction.sval] = mklbl(++_lbl);
+  }
+  std::string end = mklbl(++_lbl);
+
+  // register arguments are used where they are on the stack, instead of their slots (LDARGS, then LOCAL STINT)
+  std::map<int, int> homes;
+  int words = 0;
+  if (!body.code.empty() && body.code[0].op == postfix_opcode::LDARGS) {
+    for (words = 0; words < body.code[0].ival; words++) {
+      homes[body.code[1 + 2 * words].ival] = args + 4 * words;
+    }
+  }
+
+  auto &code = _pf.code();
+  for (size_t ix = words ? 1 + 2 * words : 0; ix < body.code.size(); ix++) {
+    postfix_instruction instruction = body.code[ix];
+    bool leave = ix + 1 < body.code.size() && body.code[ix + 1].op == postfix_opcode::LEAVE;
+
+    if ((instruction.op == postfix_opcode::STFVAL32 || instruction.op == postfix_opcode::STFVAL64) && leave) {
+      // return value: STFVAL LEAVE RET
+      _pf.LOCAL(result);
+      if (instruction.op == postfix_opcode::STFVAL32) {
+        _pf.STINT();
+      } else {
+        _pf.STDOUBLE();
+      }
+      _pf.JMP(end);
+      ix += 2;
+      continue;
+    }
+    if (instruction.op == postfix_opcode::LEAVE) {
+      // return (LEAVE RET)
+      _pf.JMP(end);
+      ix++;
+      continue;
+    }
+
+    auto home = homes.find(instruction.ival);
+    if (instruction.op == postfix_opcode::LOCAL && home != homes.end()) {
+      instruction.ival = home->second;
+    } else if (instruction.op == postfix_opcode::LOCAL) {
+      instruction.ival = instruction.ival >= 8 ? args + instruction.ival - 8 + 4 * words : result + instruction.ival;
+    }
+    auto label = labels.find(instruction.sval);
+    if (label != labels.end() && instruction.op != postfix_opcode::COMMENT) {
+      instruction.sval = label->second;
+    }
+    code.push_back(instruction);
+  }
+  _pf.LABEL(end);
+
+  if (function->is_typed(cdk::TYPE_DOUBLE)) {
+    _pf.LOCAL(result);
+    _pf.LDDOUBLE();
+  } else if (!function->is_typed(cdk::TYPE_VOID)) {
+    _pf.LOCAL(result);
+    _pf.LDINT();
+  }
+}
+
 //---------------------------------------------------------------------------
 
 void og::postfix_writer::do_evaluation_node(og::evaluation_node * const node, int lvl) {
@@ -558,18 +1122,181 @@ void og::postfix_writer::do_evaluation_node(og::evaluation_node * const node, in
 void og::postfix_writer::do_block_node(og::block_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
   _symtab.push();
+  int offset = _offset; // blocks that are never live together share their frame space
   if (node->declarations()) {
     node->declarations()->accept(this, lvl + 2);
   }
   if (node->instructions()) {
     node->instructions()->accept(this, lvl + 2);
   }
+  _offset = offset;
   _symtab.pop();
 }
 
+/**
+ * Return the value of a call without coming back here: the arguments are
+ * evaluated as for a call and stored over the current function's own. A
+ * recursive call then jumps to the start of the body; a call to another
+ * function (with no more arguments than ours) releases the frame and jumps to
+ * it, so that it returns directly to our caller.
+ *
+ * The frame must not be referenced after the arguments are overwritten (no
+ * addresses taken, no stack allocations), and both functions must return the
+ * value the same way (not as tuples).
+ */
+bool og::postfix_writer::tail_call(og::return_node *const node, int lvl) {
+  if (!_frameReusable || _function->is_typed(cdk::TYPE_VOID) || _function->is_typed(cdk::TYPE_STRUCT)) return false;
+
+  auto retval = dynamic_cast<og::tuple_node*>(node->retval());
+  if (!retval || retval->size() != 1) return false;
+  auto call = dynamic_cast<og::function_call_node*>(retval->element(0));
+  if (!call || _hoisted.count(call)) return false;
+
+  std::shared_ptr<og::symbol> callee = _symtab.find(call->identifier());
+  bool self = callee == _function;
+  if (!self && _inlinable.count(call->identifier())) return false; // better copied in place
+  if (_referenceArguments.count(call->identifier())) return false;
+  bool word = callee->is_typed(cdk::TYPE_INT) || callee->is_typed(cdk::TYPE_POINTER) || callee->is_typed(cdk::TYPE_STRING);
+  if (_function->is_typed(cdk::TYPE_DOUBLE) ? !callee->is_typed(cdk::TYPE_DOUBLE) : !word) return false;
+
+  if (!self && _accumulator) return false; // the accumulated value must still be combined with the result
+  // the other function's stack arguments must fit in ours
+  int words = register_words(call->identifier());
+  int argsSize = call->arguments() ? callee->argsType()->size() - 4 * words : 0;
+  int ourArgsSize = _function->argsType() ? _function->argsType()->size() - 4 * _argumentHomes.size() : 0;
+  if (argsSize > ourArgsSize) return false;
+
+  size_t size = push_arguments(call, callee, lvl);
+  if (self) {
+    store_arguments(size);
+    reenter();
+  } else {
+    if (words) _pf.STARGS(words);
+    store_arguments(size - 4 * words, false);
+    _pf.LEAVE();
+    _pf.JMP(fix_function_name(call->identifier()));
+  }
+  return true;
+}
+
+/**
+ * Replace the current function's arguments by those on the stack (or, for
+ * a tail call to another function, fill the stack slots of its arguments).
+ */
+void og::postfix_writer::store_arguments(size_t argsSize, bool self) {
+  size_t homes = self ? 4 * _argumentHomes.size() : 0;
+  for (size_t ix = 0; ix < argsSize; ix += 4) {
+    _pf.LOCAL(ix < homes ? _argumentHomes[ix / 4] : 8 + ix - homes);
+    _pf.STINT();
+  }
+}
+
+/** Jump back to the start of the current function's body. */
+void og::postfix_writer::reenter() {
+  if (_entry.empty()) _entry = mklbl(++_lbl);
+  _pf.JMP(_entry);
+}
+
+/** The self call and the other operand of "f(...) op e" or "e op f(...)", if op is integer + or *. */
+static og::function_call_node *recursive_operand(cdk::expression_node *const expr, const std::string &function,
+                                                 cdk::expression_node *&other, bool &callFirst) {
+  auto binary = dynamic_cast<cdk::binary_operation_node*>(expr);
+  if (!binary || !binary->is_typed(cdk::TYPE_INT)) return nullptr;
+  if (!dynamic_cast<cdk::add_node*>(binary) && !dynamic_cast<cdk::mul_node*>(binary)) return nullptr;
+
+  for (auto call : {dynamic_cast<og::function_call_node*>(binary->left()),
+                    dynamic_cast<og::function_call_node*>(binary->right())}) {
+    if (!call || call->identifier() != function) continue;
+    callFirst = call == binary->left();
+    other = callFirst ? binary->right() : binary->left();
+    if (!other->is_typed(cdk::TYPE_INT)) return nullptr;
+    return call;
+  }
+  return nullptr;
+}
+
+/**
+ * The operation (ADD or MUL) that, accumulated across iterations, turns the
+ * function's linear recursion into a loop: every return is either a value,
+ * a plain recursive call, or "f(...) op e" / "e op f(...)" with the same op.
+ * Since integer + and * are associative and commutative, f(x) = e op f(y)
+ * becomes acc = acc op e; x = y; and returning v becomes returning acc op v.
+ *
+ * In "f(...) op e", e would be evaluated before the deeper calls instead of
+ * after them: that is only done for pure functions. Returns NOP if the
+ * function is not transformed.
+ */
+og::postfix_opcode og::postfix_writer::accumulation(const std::vector<og::return_node*> &returns, bool pure) {
+  postfix_opcode op = postfix_opcode::NOP;
+  if (!_function->is_typed(cdk::TYPE_INT) || !_frameReusable) return op;
+
+  for (auto node : returns) {
+    auto retval = dynamic_cast<og::tuple_node*>(node->retval());
+    if (!retval || retval->size() != 1) continue;
+
+    cdk::expression_node *other;
+    bool callFirst;
+    if (!recursive_operand(retval->element(0), _function->name(), other, callFirst)) continue;
+    if (callFirst && !pure) return postfix_opcode::NOP;
+
+    auto found = dynamic_cast<cdk::add_node*>(retval->element(0)) ? postfix_opcode::ADD : postfix_opcode::MUL;
+    if (op != postfix_opcode::NOP && op != found) return postfix_opcode::NOP;
+    op = found;
+  }
+  return op;
+}
+
+/** A return from a function whose recursion is accumulated (see accumulation()). */
+bool og::postfix_writer::accumulate(og::return_node *const node, int lvl) {
+  auto retval = dynamic_cast<og::tuple_node*>(node->retval());
+  if (!retval || retval->size() != 1) return false;
+  auto call = dynamic_cast<og::function_call_node*>(retval->element(0));
+  if (call && call->identifier() == _function->name() && !_hoisted.count(call)) return false; // a plain tail call
+
+  auto update = [this]() {
+    _pf.LOCAL(_accumulator);
+    _pf.LDINT();
+    _pf.emit({_accumulate});
+  };
+
+  cdk::expression_node *other;
+  bool callFirst;
+  call = recursive_operand(retval->element(0), _function->name(), other, callFirst);
+  if (!call || _hoisted.count(call) || _hoisted.count(retval->element(0))) {
+    load(node->retval(), lvl, _returnTempOffset);
+    update();
+    _pf.STFVAL32();
+    _pf.LEAVE();
+    _pf.RET();
+    return true;
+  }
+
+  size_t argsSize = 0;
+  if (callFirst) argsSize = push_arguments(call, _function, lvl);
+  other->accept(this, lvl + 2);
+  update();
+  _pf.LOCAL(_accumulator);
+  _pf.STINT();
+  if (!callFirst) argsSize = push_arguments(call, _function, lvl);
+  store_arguments(argsSize);
+  reenter();
+  return true;
+}
+
 void og::postfix_writer::do_return_node(og::return_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
-  if (!_function->is_typed(cdk::TYPE_VOID)) {
+  if (_accumulator && accumulate(node, lvl)) return;
+  if (tail_call(node, lvl)) return;
+  if (_registerReturns.count(_function->name())) {
+    load(node->retval(), lvl, _returnTempOffset);
+    if (_function->type()->size() == 8) {
+      _pf.STFVALPAIR();
+    } else {
+      _pf.STFVAL32();
+    }
+  } else if (_function->is_typed(cdk::TYPE_STRUCT)) {
+    initialize(_function->type(), node->retval(), lvl, _returnTempOffset, [this]() { _pf.LOCV(8); });
+  } else if (!_function->is_typed(cdk::TYPE_VOID)) {
     load(node->retval(), lvl, _returnTempOffset);
     if (_function->is_typed(cdk::TYPE_INT) || _function->is_typed(cdk::TYPE_STRING)
         || _function->is_typed(cdk::TYPE_POINTER)) {
@@ -579,8 +1306,6 @@ void og::postfix_writer::do_return_node(og::return_node * const node, int lvl) {
         _pf.I2D();
       }
       _pf.STFVAL64();
-    } else if (_function->is_typed(cdk::TYPE_STRUCT)) {
-      store(_function->type(), node->retval()->type(), [this]() { _pf.LOCV(8); });
     } else {
       // cannot happen!
       ERROR("ICE: unknown return type");
@@ -649,18 +1374,37 @@ void og::postfix_writer::do_for_node(og::for_node * const node, int lvl) {
   _forEnd.push(lblend = ++_lbl);
 
   _symtab.push();
+  int offset = _offset;
 
   if (node->initializers()) {
     node->initializers()->accept(this, lvl);
   }
 
-  _pf.LABEL(mklbl(lblini));
+  // counted loops may be unrolled: completely when the trip count is small
+  long long trips = -1;
+  int factor = unroll_factor(node, trips, lvl);
+  if (trips >= 0) {
+    unroll_completely(node, trips, lvl);
+  } else {
+    // loops are rotated: the condition is tested once on entry and then at the
+    // bottom, jumping back to the block (tuple conditions are still tested on top)
+    bool rotated = node->condition() && !node->condition()->is_typed(cdk::TYPE_STRUCT);
+    if (rotated) {
+      _pf.COMMENT("FOR entry condition");
+      branch(node->condition(), lblend, false, lvl);
+    }
+    hoist_invariants(node, lvl);
+    start_inductions(node, lvl);
+    if (factor > 1) {
+      unroll_partially(node, factor, lvl);
+    }
+
+    _pf.LABEL(mklbl(lblini));
 
-  os() << "        ;; FOR condition" << std::endl;
-  if (node->condition()) {
-    load(node->condition(), lvl, tempOffsetForNode(node));
+    if (node->condition() && !rotated) {
+      _pf.COMMENT("FOR condition");
+      load(node->condition(), lvl, tempOffsetForNode(node));
 
-    if (node->condition()->is_typed(cdk::TYPE_STRUCT)) {
       // condition is at the top of the stack, move it to the start of the tuple (shortens tuple by 4 bytes)
       _pf.SP();
       _pf.INT(node->condition()->type()->size() - 4);
@@ -677,25 +1421,46 @@ void og::postfix_writer::do_for_node(og::for_node * const node, int lvl) {
       if (to_trash) {
         _pf.TRASH(to_trash);
       }
-    }
 
-    _pf.JZ(mklbl(lblend));
-  }
+      _pf.JZ(mklbl(lblend));
+    }
 
-  os() << "        ;; FOR block" << std::endl;
-  if (node->block()) {
-    node->block()->accept(this, lvl + 2);
-  }
+    _pf.COMMENT("FOR block");
+    if (node->block()) {
+      node->block()->accept(this, lvl + 2);
+    }
 
-  os() << "        ;; FOR increments" << std::endl;
-  _pf.LABEL(mklbl(lblincr));
-  if (node->increments()) {
-    node->increments()->accept(this, lvl);
+    _pf.COMMENT("FOR increments");
+    _pf.LABEL(mklbl(lblincr));
+    auto inductions = _loopInductions.find(node);
+    bool reduced = inductions != _loopInductions.end() && factor <= 1; // unrolled copies keep the index
+    if (node->increments() && !(reduced && inductions->second.dropIncrements)) {
+      node->increments()->accept(this, lvl);
+    }
+    advance_inductions(node);
+
+    if (reduced && inductions->second.test >= 0) {
+      // the pointer reaches its final value exactly when the index reaches the bound
+      _pf.COMMENT("FOR condition");
+      _pf.LOCAL(tempOffsetForNode(inductions->second.pointers[inductions->second.test].index));
+      _pf.LDINT();
+      _pf.LOCAL(tempOffsetForNode(node->condition()));
+      _pf.LDINT();
+      _pf.JNE(mklbl(lblini));
+    } else if (rotated) {
+      _pf.COMMENT("FOR condition");
+      branch(node->condition(), lblini, true, lvl);
+    } else {
+      _pf.JMP(mklbl(lblini));
+    }
   }
-
-  _pf.JMP(mklbl(lblini));
   _pf.LABEL(mklbl(lblend));
 
+  for (auto expr : _loopInvariants[node]) {
+    _hoisted.erase(expr);
+  }
+  stop_inductions(node);
+  _offset = offset;
   _symtab.pop();
 
   _forIni.pop();
@@ -703,6 +1468,248 @@ void og::postfix_writer::do_for_node(og::for_node * const node, int lvl) {
   _forEnd.pop();
 }
 
+/**
+ * Number of copies of the block of a counted loop (when unrolling is enabled):
+ * as many as fit the size budget, or every iteration (trips) when the trip
+ * count is known and small enough.
+ */
+int og::postfix_writer::unroll_factor(og::for_node *const node, long long &trips, int lvl) {
+  static const size_t budget = 160; // postfix instructions for all copies
+
+  auto count = _loopCounts.find(node);
+  if (!options::get().unroll() || count == _loopCounts.end()) return 1;
+
+  // the size of a copy is measured by generating it once
+  auto &code = _pf.code();
+  size_t mark = code.size();
+  int offset = _offset;
+  if (node->block()) node->block()->accept(this, lvl + 2);
+  if (node->increments()) node->increments()->accept(this, lvl);
+  size_t size = 0;
+  for (size_t ix = mark; ix < code.size(); ix++) {
+    if (code[ix].op != postfix_opcode::COMMENT) size++;
+  }
+  code.erase(code.begin() + mark, code.end());
+  _offset = offset;
+
+  if (count->second.trips >= 0 && (size_t)count->second.trips * size <= budget) {
+    trips = count->second.trips;
+    return trips;
+  }
+  if (count->second.step != 1 && count->second.step != -1) return 1;
+
+  int factor = options::get().unroll();
+  while (factor > 1 && factor * size > budget) factor /= 2;
+  return factor;
+}
+
+/**
+ * Emit copies of the block, each followed by the increments (continue jumps
+ * to the copy's increments). When the block only uses the index through
+ * induction pointers, the copies index at fixed offsets from the pointers
+ * instead, and the index and pointers advance once, after the last copy.
+ */
+void og::postfix_writer::unrolled_copies(og::for_node *const node, int copies, int lvl) {
+  auto &count = _loopCounts[node];
+  int offset = _offset;
+
+  for (int k = 0; k < copies; k++) {
+    int lblnext = ++_lbl;
+    _forIncr.push(lblnext);
+    if (count.indexOnly) shift_inductions(node, k);
+
+    _pf.COMMENT("FOR block (unrolled)");
+    _offset = offset; // each copy reuses the block's variables
+    if (node->block()) {
+      node->block()->accept(this, lvl + 2);
+    }
+    _pf.LABEL(mklbl(lblnext));
+    if (!count.indexOnly) {
+      if (node->increments()) node->increments()->accept(this, lvl);
+      advance_inductions(node);
+    }
+
+    _forIncr.pop();
+  }
+
+  if (count.indexOnly) {
+    // i = i + copies * step
+    _pf.COMMENT("FOR increments (unrolled)");
+    auto increments = dynamic_cast<og::tuple_node*>(dynamic_cast<og::evaluation_node*>(node->increments())->argument());
+    auto increment = dynamic_cast<cdk::assignment_node*>(increments->element(0));
+    count.condition->left()->accept(this, lvl);
+    _pf.INT(copies * count.step);
+    _pf.ADD();
+    increment->lvalue()->accept(this, lvl);
+    _pf.STINT();
+
+    shift_inductions(node, 0);
+    advance_inductions(node, copies);
+  }
+}
+
+/** The loop runs exactly trips times: no condition is tested. */
+void og::postfix_writer::unroll_completely(og::for_node *const node, long long trips, int lvl) {
+  if (trips == 0) return;
+
+  hoist_invariants(node, lvl);
+  start_inductions(node, lvl);
+  unrolled_copies(node, trips, lvl);
+}
+
+/**
+ * Run factor copies of the block while at least factor iterations remain,
+ * then test the condition again for the remainder loop that follows.
+ */
+void og::postfix_writer::unroll_partially(og::for_node *const node, int factor, int lvl) {
+  int lblmain = ++_lbl, lblrest = ++_lbl;
+  auto &count = _loopCounts[node];
+
+  // remaining iterations: (bound - i) or (i - bound), plus one for <= and >=, as
+  // an unsigned value (the entry test holds); the shift leaves zero below factor
+  auto remaining = [&]() {
+    auto condition = count.condition;
+    bool inclusive = dynamic_cast<cdk::le_node*>(condition) || dynamic_cast<cdk::ge_node*>(condition);
+    if (count.step > 0) {
+      condition->right()->accept(this, lvl);
+      condition->left()->accept(this, lvl);
+    } else {
+      condition->left()->accept(this, lvl);
+      condition->right()->accept(this, lvl);
+    }
+    _pf.SUB();
+    if (inclusive) {
+      _pf.INT(1);
+      _pf.ADD();
+    }
+    int bits = 0;
+    while ((1 << bits) < factor) bits++;
+    _pf.INT(bits);
+    _pf.SHTRU();
+  };
+
+  _pf.COMMENT("FOR unrolled");
+  remaining();
+  _pf.JZ(mklbl(lblrest));
+  _pf.LABEL(mklbl(lblmain));
+  int offset = _offset;
+  unrolled_copies(node, factor, lvl);
+  _offset = offset;
+  remaining();
+  _pf.JNZ(mklbl(lblmain));
+
+  _pf.LABEL(mklbl(lblrest));
+  _pf.COMMENT("FOR remainder");
+  branch(node->condition(), _forEnd.top(), false, lvl);
+}
+
+/**
+ * Compute the loop's invariant expressions into their temporaries. From here
+ * to the end of the loop, visiting one of them just loads the temporary.
+ */
+void og::postfix_writer::hoist_invariants(og::for_node *const node, int lvl) {
+  auto invariants = _loopInvariants.find(node);
+  if (invariants == _loopInvariants.end()) return;
+
+  _pf.COMMENT("FOR invariants");
+  for (auto expr : invariants->second) {
+    expr->accept(this, lvl);
+    _pf.LOCAL(tempOffsetForNode(expr));
+    if (expr->is_typed(cdk::TYPE_DOUBLE) && !dynamic_cast<cdk::lvalue_node*>(expr)) {
+      _pf.STDOUBLE();
+    } else {
+      _pf.STINT(); // values and element addresses
+    }
+    _hoisted.insert(expr);
+  }
+}
+
+/**
+ * Point each induction pointer at base[i] (and compute &base[bound] when it
+ * replaces the condition). From here to the end of the loop, the indexing it
+ * covers just loads the pointer.
+ */
+void og::postfix_writer::start_inductions(og::for_node *const node, int lvl) {
+  auto inductions = _loopInductions.find(node);
+  if (inductions == _loopInductions.end()) return;
+
+  auto address = [&](const loop_invariant_finder::induction_pointer &pointer, cdk::expression_node *const index) {
+    pointer.base->accept(this, lvl);
+    index->accept(this, lvl);
+    int size = cdk::reference_type_cast(pointer.base->type())->referenced()->size();
+    if (size != 1) {
+      _pf.INT(size);
+      _pf.MUL();
+    }
+    _pf.ADD();
+  };
+
+  _pf.COMMENT("FOR induction pointers");
+  auto &loop = inductions->second;
+  for (auto &pointer : loop.pointers) {
+    address(pointer, pointer.index);
+    _pf.LOCAL(tempOffsetForNode(pointer.index));
+    _pf.STINT();
+    for (auto &access : pointer.accesses) {
+      _inductionAccesses[access.first] = { tempOffsetForNode(pointer.index), access.second };
+    }
+  }
+  if (loop.test >= 0) {
+    address(loop.pointers[loop.test], loop.bound);
+    _pf.LOCAL(tempOffsetForNode(node->condition()));
+    _pf.STINT();
+  }
+}
+
+void og::postfix_writer::advance_inductions(og::for_node *const node, int times) {
+  auto inductions = _loopInductions.find(node);
+  if (inductions == _loopInductions.end()) return;
+
+  for (auto &pointer : inductions->second.pointers) {
+    _pf.LOCAL(tempOffsetForNode(pointer.index));
+    _pf.LDINT();
+    _pf.INT(pointer.step * times);
+    _pf.ADD();
+    _pf.LOCAL(tempOffsetForNode(pointer.index));
+    _pf.STINT();
+  }
+}
+
+/** Make the indexing address the given unrolled copy's elements (the pointers are not advanced between copies). */
+void og::postfix_writer::shift_inductions(og::for_node *const node, int copy) {
+  auto inductions = _loopInductions.find(node);
+  if (inductions == _loopInductions.end()) return;
+
+  for (auto &pointer : inductions->second.pointers) {
+    for (auto &access : pointer.accesses) {
+      _inductionAccesses[access.first].second = access.second + copy * pointer.step;
+    }
+  }
+}
+
+void og::postfix_writer::stop_inductions(og::for_node *const node) {
+  auto inductions = _loopInductions.find(node);
+  if (inductions == _loopInductions.end()) return;
+
+  for (auto &pointer : inductions->second.pointers) {
+    for (auto &access : pointer.accesses) {
+      _inductionAccesses.erase(access.first);
+    }
+  }
+}
+
+bool og::postfix_writer::load_hoisted(cdk::typed_node *const node) {
+  if (!_hoisted.count(node)) return false;
+
+  _pf.LOCAL(tempOffsetForNode(node));
+  if (node->is_typed(cdk::TYPE_DOUBLE) && !dynamic_cast<cdk::lvalue_node*>(node)) {
+    _pf.LDDOUBLE();
+  } else {
+    _pf.LDINT();
+  }
+  return true;
+}
+
 void og::postfix_writer::do_continue_node(og::continue_node * const node, int lvl) {
   if (_forIni.size() != 0) {
     _pf.JMP(mklbl(_forIncr.top())); // jump to next cycle
@@ -724,19 +1731,131 @@ void og::postfix_writer::do_break_node(og::break_node * const node, int lvl) {
 void og::postfix_writer::do_if_node(og::if_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS
   int lbl1;
-  node->condition()->accept(this, lvl);
-  _pf.JZ(mklbl(lbl1 = ++_lbl));
+  branch(node->condition(), lbl1 = ++_lbl, false, lvl);
   node->block()->accept(this, lvl + 2);
   _pf.LABEL(mklbl(lbl1));
 }
 
 //---------------------------------------------------------------------------
 
+// "x == k" or "k == x", for an integer variable x and a (possibly negated) literal k
+static cdk::rvalue_node *compared_variable(cdk::expression_node *const condition, int &value) {
+  auto tuple = dynamic_cast<og::tuple_node*>(condition);
+  if (tuple && tuple->size() == 1) return compared_variable(tuple->element(0), value);
+
+  auto eq = dynamic_cast<cdk::eq_node*>(condition);
+  if (!eq) return nullptr;
+  for (auto [subject, constant] : { std::make_pair(eq->left(), eq->right()), std::make_pair(eq->right(), eq->left()) }) {
+    auto rvalue = dynamic_cast<cdk::rvalue_node*>(subject);
+    if (!rvalue || !rvalue->is_typed(cdk::TYPE_INT) || !dynamic_cast<cdk::variable_node*>(rvalue->lvalue())) continue;
+    auto neg = dynamic_cast<cdk::neg_node*>(constant);
+    auto literal = dynamic_cast<cdk::integer_node*>(neg ? neg->argument() : constant);
+    if (!literal) continue;
+    value = neg ? -(uint32_t)literal->value() : literal->value();
+    return rvalue;
+  }
+  return nullptr;
+}
+
+/**
+ * An elif chain that compares one integer variable with distinct constants
+ * ("if x == 1 then ... elif x == 7 then ... else ...") jumps straight to its
+ * case: through a table, when the constants are dense, or after a binary
+ * search over them. Returns false for other chains (and short ones).
+ */
+bool og::postfix_writer::dispatch(og::if_else_node *const node, int lvl) {
+  static const size_t minimum = 4; // cases
+  static const size_t density = 3; // table entries per case, at most
+
+  cdk::rvalue_node *subject = nullptr;
+  std::vector<std::pair<int, cdk::basic_node*>> cases;
+  std::set<int> values;
+  cdk::basic_node *otherwise = nullptr; // the first link that does not compare the same variable with a new constant
+  for (cdk::basic_node *link = node; link;) {
+    auto ifelse = dynamic_cast<og::if_else_node*>(link);
+    auto ifnode = dynamic_cast<og::if_node*>(link);
+    int value = 0;
+    auto rvalue = ifelse ? compared_variable(ifelse->condition(), value)
+        : ifnode ? compared_variable(ifnode->condition(), value) : nullptr;
+    auto name = [](cdk::rvalue_node *rvalue) { return static_cast<cdk::variable_node*>(rvalue->lvalue())->name(); };
+    if (!rvalue || (subject && name(rvalue) != name(subject)) || values.count(value)) {
+      otherwise = link;
+      break;
+    }
+    if (!subject) subject = rvalue;
+    values.insert(value);
+    cases.emplace_back(value, ifelse ? ifelse->thenblock() : ifnode->block());
+    link = ifelse ? ifelse->elseblock() : nullptr;
+  }
+  if (cases.size() < minimum) return false;
+
+  std::vector<std::string> labels;
+  std::vector<std::pair<int, size_t>> sorted;
+  for (size_t ix = 0; ix < cases.size(); ix++) {
+    labels.push_back(mklbl(++_lbl));
+    sorted.emplace_back(cases[ix].first, ix);
+  }
+  std::sort(sorted.begin(), sorted.end());
+  int end = ++_lbl;
+  std::string other = otherwise ? mklbl(++_lbl) : mklbl(end);
+
+  long long range = (long long)sorted.back().first - sorted.front().first + 1;
+  if (range <= (long long)(density * cases.size())) {
+    // x - low, compared (unsigned) with the table's size
+    std::vector<std::string> table(range, other);
+    for (auto &[value, ix] : sorted) {
+      table[(long long)value - sorted.front().first] = labels[ix];
+    }
+    subject->accept(this, lvl);
+    _pf.INT(sorted.front().first);
+    _pf.SUB();
+    _pf.JTABLE(mklbl(++_lbl), table, other);
+  } else {
+    search(subject, sorted, 0, sorted.size(), labels, other, lvl);
+  }
+
+  for (size_t ix = 0; ix < cases.size(); ix++) {
+    _pf.LABEL(labels[ix]);
+    cases[ix].second->accept(this, lvl + 2);
+    _pf.JMP(mklbl(end));
+  }
+  if (otherwise) {
+    _pf.LABEL(other);
+    otherwise->accept(this, lvl + 2);
+  }
+  _pf.LABEL(mklbl(end));
+  return true;
+}
+
+// a few equality tests, or a split at the middle case of [first, last)
+void og::postfix_writer::search(cdk::rvalue_node *const subject, const std::vector<std::pair<int, size_t>> &cases,
+                                size_t first, size_t last, const std::vector<std::string> &labels,
+                                const std::string &otherwise, int lvl) {
+  if (last - first <= 3) {
+    for (size_t ix = first; ix < last; ix++) {
+      subject->accept(this, lvl);
+      _pf.INT(cases[ix].first);
+      _pf.JEQ(labels[cases[ix].second]);
+    }
+    _pf.JMP(otherwise);
+    return;
+  }
+
+  size_t middle = first + (last - first) / 2;
+  int upper = ++_lbl;
+  subject->accept(this, lvl);
+  _pf.INT(cases[middle].first);
+  _pf.JGE(mklbl(upper));
+  search(subject, cases, first, middle, labels, otherwise, lvl);
+  _pf.LABEL(mklbl(upper));
+  search(subject, cases, middle, last, labels, otherwise, lvl);
+}
+
 void og::postfix_writer::do_if_else_node(og::if_else_node * const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
+  if (dispatch(node, lvl)) return;
   int lbl1, lbl2;
-  node->condition()->accept(this, lvl);
-  _pf.JZ(mklbl(lbl1 = ++_lbl));
+  branch(node->condition(), lbl1 = ++_lbl, false, lvl);
   node->thenblock()->accept(this, lvl + 2);
   _pf.JMP(mklbl(lbl2 = ++_lbl));
   _pf.LABEL(mklbl(lbl1));
@@ -748,7 +1867,7 @@ void og::postfix_writer::do_tuple_node(og::tuple_node *const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS;
   auto elements = node->elements();
 
-  os() << ";; tuple_node start\n";
+  _pf.COMMENT("tuple_node start");
   if (_inFunctionBody) {
     if (node->size() > 1) { // implies TYPE_STRUCT, when there is only one element with TYPE_STRUCT we can just pass its value up
       // store tuple in temp storage to allow indexing operations
@@ -758,7 +1877,7 @@ void og::postfix_writer::do_tuple_node(og::tuple_node *const node, int lvl) {
         exit(1);
       }
 
-      os() << ";; tuple_node load start\n";
+      _pf.COMMENT("tuple_node load start");
       int inner_tupple_base_addr_location = tuple_base_addr;
       if (_needTupleAddr) inner_tupple_base_addr_location += node->type()->size();
 
@@ -767,7 +1886,7 @@ void og::postfix_writer::do_tuple_node(og::tuple_node *const node, int lvl) {
 
         load(expr, lvl, inner_tupple_base_addr_location);
       }
-      os() << ";; tuple_node load end; store start\n";
+      _pf.COMMENT("tuple_node load end; store start");
 
       if (_needTupleAddr) {
         store(node->type(), node->type(), [this, tuple_base_addr]() { _pf.LOCAL(tuple_base_addr); });
@@ -787,7 +1906,7 @@ void og::postfix_writer::do_tuple_node(og::tuple_node *const node, int lvl) {
       (*it)->accept(this, lvl);
     }
   }
-  os() << ";; tuple_node end\n";
+  _pf.COMMENT("tuple_node end");
 }
 
 void og::postfix_writer::set_declaration_offsets(og::variable_declaration_node * const node) {
@@ -867,6 +1986,16 @@ void og::postfix_writer::store(std::shared_ptr<cdk::basic_type> lvalType, std::s
   }
 }
 
+// globals with real values are 8-byte aligned (tuples only at their base: their layout is fixed)
+static bool contains_real(std::shared_ptr<cdk::basic_type> type) {
+  if (type->name() == cdk::TYPE_DOUBLE) return true;
+  if (type->name() != cdk::TYPE_STRUCT) return false;
+  for (auto component : cdk::structured_type_cast(type)->components()) {
+    if (contains_real(component)) return true;
+  }
+  return false;
+}
+
 void og::postfix_writer::define_global_variable(const std::string& id, cdk::expression_node * init, int qualifier, int lvl) {
   if (qualifier == tREQUIRE) {
     _pf.EXTERN(id);
@@ -876,7 +2005,11 @@ void og::postfix_writer::define_global_variable(const std::string& id, cdk::expr
   std::shared_ptr<symbol> symbol = _symtab.find(id);
 
   _pf.DATA();
-  _pf.ALIGN();
+  if (contains_real(symbol->type())) {
+    _pf.ALIGN8();
+  } else {
+    _pf.ALIGN();
+  }
   if (qualifier == tPUBLIC) {
     _pf.GLOBAL(id, _pf.OBJ());
   }
@@ -901,6 +2034,20 @@ void og::postfix_writer::define_global_variable(const std::string& id, cdk::expr
   }
 }
 
+/** Whether the variables of "auto a, b, c = tuple" occupy the tuple's layout, with its exact types. */
+bool og::postfix_writer::contiguous(og::variable_declaration_node *const node) {
+  auto ids = node->identifiers();
+  auto rvalType = cdk::structured_type_cast(node->initializer()->type());
+  int offset = _symtab.find(ids.back())->offset();
+
+  for (ssize_t ix = ids.size() - 1; ix >= 0; ix--) {
+    std::shared_ptr<symbol> symbol = _symtab.find(ids[ix]);
+    if (symbol->offset() != offset || !same_layout(symbol->type(), rvalType->component(ix))) return false;
+    offset += rvalType->component(ix)->size();
+  }
+  return true;
+}
+
 void og::postfix_writer::do_variable_declaration_node(og::variable_declaration_node *const node, int lvl) {
   ASSERT_SAFE_EXPRESSIONS; // declare variable with typechecker
 
@@ -914,17 +2061,19 @@ void og::postfix_writer::do_variable_declaration_node(og::variable_declaration_n
 
   if (node->initializer()) {
     if (_inFunctionBody) {
-      load(node->initializer(), lvl, tempOffsetForNode(node));
-
       if (ids.size() == 1) {
         // we have 1 id to an expression (e.g.: auto a = 1, 2, 3)
-        auto id = ids[0];
-        auto type = node->initializer()->type();
-        std::shared_ptr<symbol> symbol = _symtab.find(id);
-
-        store(symbol->type(), type, [this, symbol](){ _pf.LOCAL(symbol->offset()); });
+        std::shared_ptr<symbol> symbol = _symtab.find(ids[0]);
+        initialize(symbol->type(), node->initializer(), lvl, tempOffsetForNode(node),
+                   [this, symbol](){ _pf.LOCAL(symbol->offset()); });
+      } else if (contiguous(node)) {
+        // the variables are laid out as the tuple: it is copied as a whole
+        std::shared_ptr<symbol> last = _symtab.find(ids.back());
+        initialize(node->initializer()->type(), node->initializer(), lvl, tempOffsetForNode(node),
+                   [this, last](){ _pf.LOCAL(last->offset()); });
       } else {
         // we have n-ids to a n-tuple expression (e.g.: auto a, b, c = 1, 2, 3)
+        load(node->initializer(), lvl, tempOffsetForNode(node));
 
         auto rvalType = cdk::structured_type_cast(node->initializer()->type());
 
@@ -963,7 +2112,11 @@ void og::postfix_writer::do_variable_declaration_node(og::variable_declaration_n
         _pf.EXTERN(id);
       } else {
         _pf.BSS();
-        _pf.ALIGN();
+        if (contains_real(node->type())) {
+          _pf.ALIGN8();
+        } else {
+          _pf.ALIGN();
+        }
         _pf.SALLOC(node->type()->size());
         if (node->qualifier() == tPUBLIC) {
           _pf.GLOBAL(id, _pf.OBJ());
@@ -982,13 +2135,7 @@ void og::postfix_writer::do_tuple_index_node(og::tuple_index_node *const node, i
   node->base()->accept(this, lvl);
   _needTupleAddr = old;
 
-  auto components = (cdk::structured_type_cast(node->base()->type()))->components();
-
-  int offset = 0;
-  for (ssize_t ix = components.size() - 1; ix > (ssize_t)node->index() - 1; ix--) {
-    offset += components[ix]->size();
-  }
-
+  int offset = component_offset(cdk::structured_type_cast(node->base()->type()), node->index() - 1);
   if (offset) {
     _pf.INT(offset);
     _pf.ADD();
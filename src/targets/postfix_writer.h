@@ -2,12 +2,14 @@
 #define __OG_TARGETS_POSTFIX_WRITER_H__
 
 #include "targets/basic_ast_visitor.h"
+#include "targets/postfix_buffer.h"
+#include "targets/loop_invariant_finder.h"
 
 #include <functional>
 #include <sstream>
 #include <stack>
 #include <set>
-#include <cdk/emitters/basic_postfix_emitter.h>
+#include <vector>
 #include <cdk/types/types.h>
 
 #ifndef tREQUIRE
@@ -21,7 +23,7 @@ namespace og {
   //!
   class postfix_writer: public basic_ast_visitor {
     cdk::symbol_table<og::symbol> &_symtab;
-    cdk::basic_postfix_emitter &_pf;
+    og::postfix_buffer &_pf;
     int _lbl;
     std::stack<int> _forIni, _forIncr, _forEnd;
 
@@ -34,13 +36,44 @@ namespace og {
     int _callTempOffset;
     int _returnTempOffset;
 
+    std::set<std::string> _pureFunctions; // no side effects, result depends only on the arguments
+    std::set<std::string> _privateFunctions; // defined in this module, and not public
+    std::set<std::string> _registerReturns;  // private functions that return their (small) tuples in eax:edx
+    std::set<std::string> _referenceArguments; // private functions that get a pointer to their arguments
+    std::map<std::string, int> _registerArguments; // private functions -> argument words passed in ecx (and edx)
+    std::vector<int> _argumentHomes;         // frame slots of the current function's register arguments
+    std::set<std::string> _called;           // functions called so far
+    std::map<const og::for_node*, std::vector<cdk::typed_node*>> _loopInvariants;
+    std::set<const cdk::typed_node*> _hoisted; // loop invariants whose temporary holds their value
+    std::map<const og::for_node*, loop_invariant_finder::loop_inductions> _loopInductions;
+    std::map<const og::pointer_index_node*, std::pair<int, int>> _inductionAccesses; // -> pointer temporary, byte offset
+    std::map<const og::for_node*, loop_invariant_finder::loop_count> _loopCounts;
+    std::map<std::shared_ptr<cdk::structured_type>, std::vector<int>> _componentOffsets; // see component_offset
+
+    // small functions whose calls are replaced by a copy of their code
+    struct inline_body {
+      std::vector<postfix_instruction> code; // after ENTER
+      int framesize;                         // the function's ENTER size
+    };
+    std::map<std::string, inline_body> _inlinable;
+    size_t _enter = 0;       // the current function's ENTER instruction
+    int _framesize = 0;      // its frame, as computed by the frame_size_calculator
+    int _inlineFramesize = 0; // frame space for the inlined calls (shared, one call runs at a time)
+
+    // tail calls reuse the current frame (or its argument slots)
+    bool _frameReusable = false; // no stack allocations, no addresses taken
+    std::string _entry;          // label at the start of the body, when a self tail call jumps to it
+    size_t _body = 0;            // where the body starts (after ENTER and the accumulator's initialization)
+    postfix_opcode _accumulate = postfix_opcode::NOP; // ADD or MUL: linear recursion accumulated into a loop
+    int _accumulator = 0;        // its frame slot (0: none)
+
     bool _needTupleAddr = false; // true = needs tuple to be stored somewhere and evaluate to its base address
     bool _evaledTupleAddr = false; // true = tuple was evaluated to base address
     // if the parent activates _needTupleAddr, _evaledTupleAddr must be set to true by child (child must eval address)
 
   public:
     postfix_writer(std::shared_ptr<cdk::compiler> compiler, cdk::symbol_table<og::symbol> &symtab,
-                   cdk::basic_postfix_emitter &pf) :
+                   og::postfix_buffer &pf) :
         basic_ast_visitor(compiler), _symtab(symtab), _pf(pf), _lbl(0) {
       // ensure builtin functions are available
       auto int_t = cdk::make_primitive_type(4, cdk::TYPE_INT);
@@ -55,6 +88,7 @@ namespace og {
       for (auto sym : {argc, argv, envp}) {
         _symtab.insert(sym->name(), sym);
         _extern_functions.insert(sym->name());
+        _pureFunctions.insert(sym->name());
       }
     }
 
@@ -87,10 +121,62 @@ namespace og {
       return it->second;
     }
 
+    /** Argument words that a function gets in registers (see choose_argument_registers). */
+    inline int register_words(const std::string &function) const {
+      auto it = _registerArguments.find(function);
+      return it == _registerArguments.end() ? 0 : it->second;
+    }
+
+    /** Offset of a tuple's component from the tuple's base address (component 0 is the highest). */
+    inline int component_offset(std::shared_ptr<cdk::structured_type> type, size_t ix) {
+      auto &offsets = _componentOffsets[type];
+      if (offsets.empty() && type->length() > 0) {
+        offsets.resize(type->length());
+        int offset = 0;
+        for (size_t cx = type->length(); cx-- > 0;) {
+          offsets[cx] = offset;
+          offset += type->component(cx)->size();
+        }
+      }
+      return offsets[ix];
+    }
+
     void processIDBinaryExpression(cdk::binary_operation_node *const node, int lvl);
     void processIDComparison(cdk::binary_operation_node *const node, int lvl);
+    void branch(cdk::expression_node *const condition, int lbl, bool jumpIfTrue, int lvl);
+    bool dispatch(og::if_else_node *const node, int lvl);
+    void search(cdk::rvalue_node *const subject, const std::vector<std::pair<int, size_t>> &cases, size_t first,
+                size_t last, const std::vector<std::string> &labels, const std::string &otherwise, int lvl);
+    void hoist_invariants(og::for_node *const node, int lvl);
+    bool load_hoisted(cdk::typed_node *const node);
+    void start_inductions(og::for_node *const node, int lvl);
+    void advance_inductions(og::for_node *const node, int times = 1);
+    void shift_inductions(og::for_node *const node, int copy);
+    void stop_inductions(og::for_node *const node);
+    void choose_return_registers(std::shared_ptr<og::symbol> function);
+    void choose_argument_registers(std::shared_ptr<og::symbol> function);
+    void inline_call(const inline_body &body, std::shared_ptr<og::symbol> function, int argsSize);
+    bool inlinable(const std::vector<postfix_instruction> &code);
+    bool tail_call(og::return_node *const node, int lvl);
+    size_t push_arguments(og::function_call_node *const node, std::shared_ptr<og::symbol> function, int lvl);
+    bool by_reference(og::function_definition_node *const node, loop_invariant_finder &finder);
+    void pass_by_reference(og::function_definition_node *const node);
+    size_t reference_arguments(og::function_call_node *const node, std::shared_ptr<og::symbol> function, int lvl);
+    void store_arguments(size_t argsSize, bool self = true);
+    void reenter();
+    postfix_opcode accumulation(const std::vector<og::return_node*> &returns, bool pure);
+    bool accumulate(og::return_node *const node, int lvl);
+    int unroll_factor(og::for_node *const node, long long &trips, int lvl);
+    void unrolled_copies(og::for_node *const node, int copies, int lvl);
+    void unroll_completely(og::for_node *const node, long long trips, int lvl);
+    void unroll_partially(og::for_node *const node, int factor, int lvl);
     void load_from_base(std::shared_ptr<cdk::basic_type> type, std::function<void()> baseSupplier, int offset = 0);
     void load(cdk::typed_node *const node, int lvl, int tempOffset = 0);
+    bool evaluate(cdk::typed_node *const node, int lvl, int tempOffset);
+    void initialize(std::shared_ptr<cdk::basic_type> lvalType, cdk::typed_node *const value, int lvl, int tempOffset,
+                    std::function<void()> baseSupplier);
+    bool contiguous(og::variable_declaration_node *const node);
+    void copy(size_t size, std::function<void()> sourceSupplier, std::function<void()> baseSupplier);
     void set_declaration_offsets(og::variable_declaration_node * const node);
     void define_global_variable(const std::string& id, cdk::expression_node * init, int qualifier, int lvl);
     void store(std::shared_ptr<cdk::basic_type> lvalType, std::shared_ptr<cdk::basic_type> rvalType, std::function<void()> baseSupplier, int offset = 0);
@@ -0,0 +1,7 @@
+#include "targets/register_target.h"
+
+/**
+ * Register-allocating ix86 code.
+ * @var create and register an evaluator for ASM-REG targets.
+ */
+og::register_target og::register_target::_self;
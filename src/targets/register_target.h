@@ -0,0 +1,55 @@
+#ifndef __OG_TARGETS_REGISTER_TARGET_H__
+#define __OG_TARGETS_REGISTER_TARGET_H__
+
+#include <cdk/targets/basic_target.h>
+#include <cdk/ast/basic_node.h>
+#include "targets/postfix_writer.h"
+#include "targets/ix86_register_writer.h"
+#include "targets/postfix_peephole.h"
+
+#include <cdk/emitters/postfix_ix86_emitter.h>
+
+namespace og {
+
+  class register_target: public cdk::basic_target {
+    static register_target _self;
+
+  private:
+    register_target() :
+        cdk::basic_target("asm-reg") {
+    }
+
+  public:
+    bool evaluate(std::shared_ptr<cdk::compiler> compiler) {
+      // this symbol table will be used to check identifiers
+      // during code generation
+      cdk::symbol_table<og::symbol> symtab;
+
+      // postfix code is generated into memory first
+      postfix_buffer buffer;
+
+      // generate postfix code from the syntax tree
+      postfix_writer writer(compiler, symtab, buffer);
+      compiler->ast()->accept(&writer, 0);
+
+      for (std::string ext : writer.extern_functions())
+        buffer.EXTERN(ext);
+
+      postfix_peephole peephole;
+      peephole.run(buffer);
+      if (compiler->debug()) peephole.report(std::cerr);
+
+      // functions are rewritten to use registers, whatever
+      // cannot be is left to the backend postfix machine
+      cdk::postfix_ix86_emitter pf(compiler);
+      ix86_register_writer regwriter(compiler, pf);
+      regwriter.write(buffer);
+
+      return true;
+    }
+
+  };
+
+} // og
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef __OG_TARGETS_TAC_H__
+#define __OG_TARGETS_TAC_H__
+
+#include <string>
+#include <vector>
+
+namespace og {
+
+  /**
+   * Three-address code over virtual registers (32-bit integer/pointer values only).
+   * Frame slots are addressed relative to the frame pointer, as in the postfix code.
+   */
+  enum class tac_opcode {
+    MOV,      // dst = a
+    MOVI,     // dst = imm
+    ADDRESS,  // dst = label + imm
+    FRAME,    // dst = fp + imm
+    LOAD,     // dst = [a + imm]
+    STORE,    // [a + imm] = b
+    LOADF,    // dst = [fp + imm]
+    STOREF,   // [fp + imm] = b
+    LOADG,    // dst = [label + imm]
+    STOREG,   // [label + imm] = b
+    ADD, SUB, MUL, AND, OR, XOR, // dst = a op b
+    DIV, MOD, // dst = a op b (signed)
+    SHL, SHR, SAR, // dst = a shifted by b (b immediate)
+    NEG,      // dst = -a
+    NOT,      // dst = !a
+    SET,      // dst = a cond b
+    JMP,      // goto label
+    JCC,      // if (a cond b) goto label
+    JTABLE,   // if ((unsigned) a < targets.size()) goto targets[a] (through the table at b), else goto label
+    LABEL,
+    PUSH,     // push b
+    POP,      // dst = pop
+    ADJSP,    // discard imm bytes from the machine stack
+    ARG,      // set argument register imm (0: ecx, 1: edx) to b, right before a call
+    CALL,     // call label
+    RESULT,   // dst = value returned by the last call (imm 4: its second word, in edx)
+    RETVAL,   // set the function's return value to b (imm 4: its second word, in edx)
+    PARAM,    // dst = argument received in register imm (0: ecx, 1: edx), at the start of the function
+    EPILOGUE, // return to caller
+    TAILJMP,  // leave the frame and goto label (another function, which returns to our caller)
+  };
+
+  enum class tac_condition { EQ, NE, LT, LE, GT, GE };
+
+  /** An operand that is either a virtual register or an immediate (optionally label-relative). */
+  struct tac_operand {
+    int vreg = -1; // -1: immediate
+    int imm = 0;
+    std::string label; // non-empty: label + imm
+
+    bool is_vreg() const {
+      return vreg >= 0;
+    }
+  };
+
+  struct tac_instruction {
+    tac_opcode op;
+    int dst = -1;
+    int a = -1;
+    tac_operand b;
+    int imm = 0;
+    tac_condition cond = tac_condition::EQ;
+    std::string label;
+    std::vector<std::string> targets; // JTABLE only
+
+    explicit tac_instruction(tac_opcode op) :
+        op(op) {
+    }
+
+    /** Virtual registers read by this instruction. */
+    std::vector<int> uses() const {
+      std::vector<int> result;
+      if (a >= 0) result.push_back(a);
+      if (b.is_vreg()) result.push_back(b.vreg);
+      return result;
+    }
+  };
+
+  struct tac_function {
+    std::vector<tac_instruction> code;
+    int vregs = 0;
+    int framesize = 0; // as requested by ENTER
+
+    int new_vreg() {
+      return vregs++;
+    }
+  };
+
+  inline tac_operand tac_vreg(int vreg) {
+    tac_operand op;
+    op.vreg = vreg;
+    return op;
+  }
+
+  inline tac_operand tac_immediate(int imm, const std::string &label = "") {
+    tac_operand op;
+    op.imm = imm;
+    op.label = label;
+    return op;
+  }
+
+} // og
+
+#endif
@@ -0,0 +1,797 @@
+#include <climits>
+#include <cstdint>
+#include <set>
+#include "targets/tac_builder.h"
+
+//---------------------------------------------------------------------------
+//     SYMBOLIC STACK
+//---------------------------------------------------------------------------
+
+og::tac_instruction &og::tac_builder::emit(tac_opcode op) {
+  _function.code.emplace_back(op);
+  return _function.code.back();
+}
+
+int og::tac_builder::binary(tac_opcode op, int a, tac_operand b) {
+  auto &instruction = emit(op);
+  instruction.dst = _function.new_vreg();
+  instruction.a = a;
+  instruction.b = b;
+  return instruction.dst;
+}
+
+bool og::tac_builder::pop(stack_value &value) {
+  if (_stack.empty()) {
+    return fail("postfix stack underflow");
+  }
+
+  value = _stack.back();
+  _stack.pop_back();
+
+  if (value.kind == stack_value::MACHINE) {
+    auto &instruction = emit(tac_opcode::POP);
+    instruction.dst = _function.new_vreg();
+    value.kind = stack_value::VREG;
+    value.vreg = instruction.dst;
+    value.imm = 0;
+  }
+  return true;
+}
+
+bool og::tac_builder::pop_operand(tac_operand &operand) {
+  stack_value value;
+  if (!pop(value)) return false;
+
+  if (value.kind == stack_value::IMMEDIATE) {
+    operand = tac_immediate(value.imm);
+  } else if (value.kind == stack_value::SYMBOL) {
+    operand = tac_immediate(value.imm, value.label);
+  } else {
+    operand = tac_vreg(materialize(value));
+  }
+  return true;
+}
+
+void og::tac_builder::push_vreg(int vreg) {
+  stack_value value;
+  value.kind = stack_value::VREG;
+  value.vreg = vreg;
+  _stack.push_back(value);
+}
+
+void og::tac_builder::push_immediate(int imm) {
+  stack_value value;
+  value.kind = stack_value::IMMEDIATE;
+  value.imm = imm;
+  _stack.push_back(value);
+}
+
+int og::tac_builder::materialize(const stack_value &value) {
+  switch (value.kind) {
+    case stack_value::VREG:
+      if (value.imm == 0) return value.vreg;
+      return binary(tac_opcode::ADD, value.vreg, tac_immediate(value.imm));
+    case stack_value::IMMEDIATE: {
+      auto &instruction = emit(tac_opcode::MOVI);
+      instruction.dst = _function.new_vreg();
+      instruction.imm = value.imm;
+      return instruction.dst;
+    }
+    case stack_value::FRAME: {
+      escape(value.imm);
+      auto &instruction = emit(tac_opcode::FRAME);
+      instruction.dst = _function.new_vreg();
+      instruction.imm = value.imm;
+      return instruction.dst;
+    }
+    case stack_value::SYMBOL: {
+      auto &instruction = emit(tac_opcode::ADDRESS);
+      instruction.dst = _function.new_vreg();
+      instruction.imm = value.imm;
+      instruction.label = value.label;
+      return instruction.dst;
+    }
+    default:
+      return -1; // machine stack values are popped before use
+  }
+}
+
+void og::tac_builder::escape(int offset) {
+  // the size of the object is not known: assume it extends to the top of its area
+  // (locals and temporaries below the frame pointer, arguments above it)
+  if (offset < 0) {
+    _escaped.emplace_back(offset, 0);
+  } else {
+    _escaped.emplace_back(offset, INT_MAX);
+  }
+}
+
+//---------------------------------------------------------------------------
+//     CONTROL FLOW
+//---------------------------------------------------------------------------
+
+bool og::tac_builder::flush_for_call() {
+  for (auto &value : _stack) {
+    if (value.kind == stack_value::MACHINE) continue;
+
+    tac_operand operand;
+    if (value.kind == stack_value::IMMEDIATE) {
+      operand = tac_immediate(value.imm);
+    } else if (value.kind == stack_value::SYMBOL) {
+      operand = tac_immediate(value.imm, value.label);
+    } else {
+      operand = tac_vreg(materialize(value));
+    }
+    emit(tac_opcode::PUSH).b = operand;
+    value.kind = stack_value::MACHINE;
+  }
+  return true;
+}
+
+// right before the call, so that nothing else can change them (edx first: ecx may hold its value)
+void og::tac_builder::set_register_arguments() {
+  for (size_t ix = _registerArguments.size(); ix-- > 0;) {
+    auto &argument = emit(tac_opcode::ARG);
+    argument.b = _registerArguments[ix];
+    argument.imm = ix;
+  }
+  _registerArguments.clear();
+}
+
+bool og::tac_builder::canonicalize() {
+  // machine stack values are popped into registers (topmost first)
+  for (size_t ix = _stack.size(); ix-- > 0;) {
+    if (_stack[ix].kind != stack_value::MACHINE) continue;
+    auto &instruction = emit(tac_opcode::POP);
+    instruction.dst = _function.new_vreg();
+    _stack[ix].kind = stack_value::VREG;
+    _stack[ix].vreg = instruction.dst;
+    _stack[ix].imm = 0;
+  }
+
+  while (_canonical.size() < _stack.size()) {
+    _canonical.push_back(_function.new_vreg());
+  }
+
+  // values that live in another depth's canonical register are copied out first,
+  // so that the moves below do not overwrite each other
+  std::set<int> canonical(_canonical.begin(), _canonical.end());
+  for (size_t ix = 0; ix < _stack.size(); ix++) {
+    auto &value = _stack[ix];
+    if (value.kind != stack_value::VREG || !canonical.count(value.vreg)) continue;
+    if (value.vreg == _canonical[ix] && value.imm == 0) continue;
+    auto &instruction = emit(tac_opcode::MOV);
+    instruction.dst = _function.new_vreg();
+    instruction.a = value.vreg;
+    value.vreg = instruction.dst;
+  }
+
+  for (size_t ix = 0; ix < _stack.size(); ix++) {
+    auto &value = _stack[ix];
+    if (value.kind == stack_value::VREG && value.vreg == _canonical[ix] && value.imm == 0) continue;
+
+    if (value.kind == stack_value::IMMEDIATE) {
+      auto &instruction = emit(tac_opcode::MOVI);
+      instruction.dst = _canonical[ix];
+      instruction.imm = value.imm;
+    } else {
+      int vreg = materialize(value);
+      auto &instruction = emit(tac_opcode::MOV);
+      instruction.dst = _canonical[ix];
+      instruction.a = vreg;
+    }
+    value.kind = stack_value::VREG;
+    value.vreg = _canonical[ix];
+    value.imm = 0;
+  }
+  return true;
+}
+
+bool og::tac_builder::jump_to(const std::string &label) {
+  auto it = _labels.find(label);
+  if (it == _labels.end()) {
+    _labels[label] = _stack.size();
+  } else if (it->second != _stack.size()) {
+    return fail("inconsistent stack depth at " + label);
+  }
+  return true;
+}
+
+bool og::tac_builder::enter_label(const std::string &label) {
+  if (_reachable) {
+    if (!canonicalize() || !jump_to(label)) return false;
+  }
+
+  size_t depth = _labels.count(label) ? _labels[label] : 0;
+  _labels[label] = depth;
+
+  while (_canonical.size() < depth) {
+    _canonical.push_back(_function.new_vreg());
+  }
+  _stack.clear();
+  for (size_t ix = 0; ix < depth; ix++) {
+    push_vreg(_canonical[ix]);
+  }
+
+  emit(tac_opcode::LABEL).label = label;
+  _reachable = true;
+  return true;
+}
+
+bool og::tac_builder::branch(tac_condition cond, const std::string &label, bool compareWithZero) {
+  tac_operand b;
+  if (compareWithZero) {
+    b = tac_immediate(0);
+  } else if (!pop_operand(b)) {
+    return false;
+  }
+
+  stack_value value;
+  if (!pop(value)) return false;
+  int a = materialize(value);
+
+  // the compared values must survive canonicalization
+  std::set<int> canonical(_canonical.begin(), _canonical.end());
+  if (canonical.count(a)) {
+    auto &instruction = emit(tac_opcode::MOV);
+    instruction.dst = _function.new_vreg();
+    instruction.a = a;
+    a = instruction.dst;
+  }
+  if (b.is_vreg() && canonical.count(b.vreg)) {
+    auto &instruction = emit(tac_opcode::MOV);
+    instruction.dst = _function.new_vreg();
+    instruction.a = b.vreg;
+    b = tac_vreg(instruction.dst);
+  }
+
+  if (!canonicalize() || !jump_to(label)) return false;
+
+  auto &instruction = emit(tac_opcode::JCC);
+  instruction.a = a;
+  instruction.b = b;
+  instruction.cond = cond;
+  instruction.label = label;
+  return true;
+}
+
+//---------------------------------------------------------------------------
+//     OPERATIONS
+//---------------------------------------------------------------------------
+
+bool og::tac_builder::arithmetic(postfix_opcode op) {
+  stack_value a, b;
+  if (!pop(b) || !pop(a)) return false;
+
+  bool aAddress = a.kind == stack_value::VREG || a.kind == stack_value::FRAME || a.kind == stack_value::SYMBOL;
+  bool bAddress = b.kind == stack_value::VREG || b.kind == stack_value::FRAME || b.kind == stack_value::SYMBOL;
+  bool aImmediate = a.kind == stack_value::IMMEDIATE;
+  bool bImmediate = b.kind == stack_value::IMMEDIATE;
+  uint32_t ua = a.imm, ub = b.imm;
+
+  // constants are folded into addresses and displacements
+  if (op == postfix_opcode::ADD && (aImmediate || bImmediate)) {
+    if (aImmediate && bImmediate) {
+      push_immediate(ua + ub);
+      return true;
+    } else if (bImmediate && aAddress) {
+      a.imm = ua + ub;
+      _stack.push_back(a);
+      return true;
+    } else if (aImmediate && bAddress) {
+      b.imm = ua + ub;
+      _stack.push_back(b);
+      return true;
+    }
+  }
+  if (op == postfix_opcode::SUB && bImmediate) {
+    if (aImmediate) {
+      push_immediate(ua - ub);
+      return true;
+    } else if (aAddress) {
+      a.imm = ua - ub;
+      _stack.push_back(a);
+      return true;
+    }
+  }
+  if (aImmediate && bImmediate) {
+    switch (op) {
+      case postfix_opcode::MUL: push_immediate(ua * ub); return true;
+      case postfix_opcode::AND: push_immediate(ua & ub); return true;
+      case postfix_opcode::OR: push_immediate(ua | ub); return true;
+      case postfix_opcode::XOR: push_immediate(ua ^ ub); return true;
+      case postfix_opcode::SHTL: push_immediate(ua << (ub & 31)); return true;
+      case postfix_opcode::SHTRU: push_immediate(ua >> (ub & 31)); return true;
+      case postfix_opcode::SHTRS: push_immediate((int)ua >> (ub & 31)); return true;
+      default: break;
+    }
+  }
+
+  tac_opcode tac;
+  switch (op) {
+    case postfix_opcode::ADD: tac = tac_opcode::ADD; break;
+    case postfix_opcode::SUB: tac = tac_opcode::SUB; break;
+    case postfix_opcode::MUL: tac = tac_opcode::MUL; break;
+    case postfix_opcode::DIV: tac = tac_opcode::DIV; break;
+    case postfix_opcode::MOD: tac = tac_opcode::MOD; break;
+    case postfix_opcode::AND: tac = tac_opcode::AND; break;
+    case postfix_opcode::OR: tac = tac_opcode::OR; break;
+    case postfix_opcode::XOR: tac = tac_opcode::XOR; break;
+    case postfix_opcode::SHTL: tac = tac_opcode::SHL; break;
+    case postfix_opcode::SHTRU: tac = tac_opcode::SHR; break;
+    case postfix_opcode::SHTRS: tac = tac_opcode::SAR; break;
+    default: return fail("unsupported arithmetic");
+  }
+  bool shift = tac == tac_opcode::SHL || tac == tac_opcode::SHR || tac == tac_opcode::SAR;
+  if (shift && !bImmediate) {
+    return fail("shift by a variable amount");
+  }
+
+  bool commutative = tac == tac_opcode::ADD || tac == tac_opcode::MUL || tac == tac_opcode::AND
+      || tac == tac_opcode::OR || tac == tac_opcode::XOR;
+  if (commutative && aImmediate && !bImmediate) {
+    std::swap(a, b);
+    std::swap(aImmediate, bImmediate);
+  }
+
+  int va = materialize(a);
+  tac_operand vb;
+  if (bImmediate && tac != tac_opcode::DIV && tac != tac_opcode::MOD) {
+    vb = tac_immediate(b.imm);
+  } else if (b.kind == stack_value::SYMBOL && (tac == tac_opcode::ADD || tac == tac_opcode::SUB)) {
+    vb = tac_immediate(b.imm, b.label);
+  } else {
+    vb = tac_vreg(materialize(b));
+  }
+
+  push_vreg(binary(tac, va, vb));
+  return true;
+}
+
+bool og::tac_builder::comparison(tac_condition cond) {
+  stack_value a, b;
+  if (!pop(b) || !pop(a)) return false;
+
+  if (a.kind == stack_value::IMMEDIATE && b.kind == stack_value::IMMEDIATE) {
+    int x = a.imm, y = b.imm;
+    switch (cond) {
+      case tac_condition::EQ: push_immediate(x == y); break;
+      case tac_condition::NE: push_immediate(x != y); break;
+      case tac_condition::LT: push_immediate(x < y); break;
+      case tac_condition::LE: push_immediate(x <= y); break;
+      case tac_condition::GT: push_immediate(x > y); break;
+      case tac_condition::GE: push_immediate(x >= y); break;
+    }
+    return true;
+  }
+
+  int va = materialize(a);
+  tac_operand vb;
+  if (b.kind == stack_value::IMMEDIATE) {
+    vb = tac_immediate(b.imm);
+  } else {
+    vb = tac_vreg(materialize(b));
+  }
+
+  auto &instruction = emit(tac_opcode::SET);
+  instruction.dst = _function.new_vreg();
+  instruction.a = va;
+  instruction.b = vb;
+  instruction.cond = cond;
+  push_vreg(instruction.dst);
+  return true;
+}
+
+bool og::tac_builder::load() {
+  stack_value address;
+  if (!pop(address)) return false;
+
+  int dst = _function.new_vreg();
+  if (address.kind == stack_value::FRAME) {
+    auto &instruction = emit(tac_opcode::LOADF);
+    instruction.dst = dst;
+    instruction.imm = address.imm;
+  } else if (address.kind == stack_value::SYMBOL) {
+    auto &instruction = emit(tac_opcode::LOADG);
+    instruction.dst = dst;
+    instruction.imm = address.imm;
+    instruction.label = address.label;
+  } else {
+    int base = address.kind == stack_value::VREG ? address.vreg : materialize(address);
+    auto &instruction = emit(tac_opcode::LOAD);
+    instruction.dst = dst;
+    instruction.a = base;
+    instruction.imm = address.kind == stack_value::VREG ? address.imm : 0;
+  }
+
+  push_vreg(dst);
+  return true;
+}
+
+bool og::tac_builder::store() {
+  stack_value address;
+  tac_operand value;
+  if (!pop(address) || !pop_operand(value)) return false;
+
+  if (address.kind == stack_value::FRAME) {
+    auto &instruction = emit(tac_opcode::STOREF);
+    instruction.imm = address.imm;
+    instruction.b = value;
+  } else if (address.kind == stack_value::SYMBOL) {
+    auto &instruction = emit(tac_opcode::STOREG);
+    instruction.imm = address.imm;
+    instruction.label = address.label;
+    instruction.b = value;
+  } else {
+    int base = address.kind == stack_value::VREG ? address.vreg : materialize(address);
+    auto &instruction = emit(tac_opcode::STORE);
+    instruction.a = base;
+    instruction.imm = address.kind == stack_value::VREG ? address.imm : 0;
+    instruction.b = value;
+  }
+  return true;
+}
+
+//---------------------------------------------------------------------------
+
+bool og::tac_builder::process(const postfix_instruction &instruction) {
+  stack_value value;
+  tac_operand operand;
+
+  switch (instruction.op) {
+    case postfix_opcode::COMMENT:
+    case postfix_opcode::NOP:
+      return true;
+
+    case postfix_opcode::INT:
+      push_immediate(instruction.ival);
+      return true;
+
+    case postfix_opcode::LOCAL:
+      value.kind = stack_value::FRAME;
+      value.imm = instruction.ival;
+      _stack.push_back(value);
+      return true;
+
+    case postfix_opcode::ADDR:
+      value.kind = stack_value::SYMBOL;
+      value.label = instruction.sval;
+      _stack.push_back(value);
+      return true;
+
+    case postfix_opcode::LOCV: {
+      auto &load = emit(tac_opcode::LOADF);
+      load.dst = _function.new_vreg();
+      load.imm = instruction.ival;
+      push_vreg(load.dst);
+      return true;
+    }
+
+    case postfix_opcode::ADDRV: {
+      auto &load = emit(tac_opcode::LOADG);
+      load.dst = _function.new_vreg();
+      load.label = instruction.sval;
+      push_vreg(load.dst);
+      return true;
+    }
+
+    case postfix_opcode::LOCA: {
+      if (!pop_operand(operand)) return false;
+      auto &store = emit(tac_opcode::STOREF);
+      store.imm = instruction.ival;
+      store.b = operand;
+      return true;
+    }
+
+    case postfix_opcode::ADDRA: {
+      if (!pop_operand(operand)) return false;
+      auto &store = emit(tac_opcode::STOREG);
+      store.label = instruction.sval;
+      store.b = operand;
+      return true;
+    }
+
+    case postfix_opcode::LDINT:
+      return load();
+    case postfix_opcode::STINT:
+      return store();
+
+    case postfix_opcode::ADD:
+    case postfix_opcode::SUB:
+    case postfix_opcode::MUL:
+    case postfix_opcode::DIV:
+    case postfix_opcode::MOD:
+    case postfix_opcode::AND:
+    case postfix_opcode::OR:
+    case postfix_opcode::XOR:
+    case postfix_opcode::SHTL:
+    case postfix_opcode::SHTRU:
+    case postfix_opcode::SHTRS:
+      return arithmetic(instruction.op);
+
+    case postfix_opcode::EQ: return comparison(tac_condition::EQ);
+    case postfix_opcode::NE: return comparison(tac_condition::NE);
+    case postfix_opcode::LT: return comparison(tac_condition::LT);
+    case postfix_opcode::LE: return comparison(tac_condition::LE);
+    case postfix_opcode::GT: return comparison(tac_condition::GT);
+    case postfix_opcode::GE: return comparison(tac_condition::GE);
+
+    case postfix_opcode::NEG:
+    case postfix_opcode::NOT: {
+      if (!pop(value)) return false;
+      if (value.kind == stack_value::IMMEDIATE) {
+        push_immediate(instruction.op == postfix_opcode::NEG ? -(uint32_t)value.imm : !value.imm);
+        return true;
+      }
+      int a = materialize(value);
+      auto &unary = emit(instruction.op == postfix_opcode::NEG ? tac_opcode::NEG : tac_opcode::NOT);
+      unary.dst = _function.new_vreg();
+      unary.a = a;
+      push_vreg(unary.dst);
+      return true;
+    }
+
+    case postfix_opcode::DUP32:
+      if (!pop(value)) return false;
+      _stack.push_back(value);
+      _stack.push_back(value);
+      return true;
+
+    case postfix_opcode::SWAP32: {
+      stack_value other;
+      if (!pop(value) || !pop(other)) return false;
+      _stack.push_back(value);
+      _stack.push_back(other);
+      return true;
+    }
+
+    case postfix_opcode::TRASH: {
+      if (instruction.ival % 4 != 0 || (size_t)instruction.ival / 4 > _stack.size()) {
+        return fail("unsupported TRASH");
+      }
+      int machine = 0;
+      for (int ix = 0; ix < instruction.ival / 4; ix++) {
+        if (_stack.back().kind == stack_value::MACHINE) machine += 4;
+        _stack.pop_back();
+      }
+      if (machine) emit(tac_opcode::ADJSP).imm = machine;
+      return true;
+    }
+
+    case postfix_opcode::STARGS:
+      _registerArguments.clear();
+      for (int ix = 0; ix < instruction.ival; ix++) {
+        if (!pop_operand(operand)) return false;
+        _registerArguments.push_back(operand);
+      }
+      return true;
+
+    case postfix_opcode::CALL:
+      if (!flush_for_call()) return false;
+      set_register_arguments();
+      emit(tac_opcode::CALL).label = instruction.sval;
+      return true;
+
+    case postfix_opcode::LDARGS: {
+      // read before anything else can use ecx or edx (see promote_frame_slots)
+      std::vector<int> words;
+      for (int ix = 0; ix < instruction.ival; ix++) {
+        auto &param = emit(tac_opcode::PARAM);
+        param.dst = _function.new_vreg();
+        param.imm = ix;
+        words.push_back(param.dst);
+      }
+      for (size_t ix = words.size(); ix-- > 0;) {
+        push_vreg(words[ix]);
+      }
+      return true;
+    }
+
+    case postfix_opcode::LDFVAL32: {
+      auto &result = emit(tac_opcode::RESULT);
+      result.dst = _function.new_vreg();
+      push_vreg(result.dst);
+      return true;
+    }
+
+    case postfix_opcode::LDFVALPAIR:
+      for (int word : {4, 0}) {
+        auto &result = emit(tac_opcode::RESULT);
+        result.dst = _function.new_vreg();
+        result.imm = word;
+        push_vreg(result.dst);
+      }
+      return true;
+
+    case postfix_opcode::STFVAL32:
+      if (!pop_operand(operand)) return false;
+      emit(tac_opcode::RETVAL).b = operand;
+      return true;
+
+    case postfix_opcode::STFVALPAIR: {
+      // both words are popped before eax is set
+      tac_operand high;
+      if (!pop_operand(operand) || !pop_operand(high)) return false;
+      emit(tac_opcode::RETVAL).b = operand;
+      auto &second = emit(tac_opcode::RETVAL);
+      second.b = high;
+      second.imm = 4;
+      return true;
+    }
+
+    case postfix_opcode::LEAVE:
+      _leaving = true;
+      return true;
+    case postfix_opcode::RET:
+      emit(tac_opcode::EPILOGUE);
+      _stack.clear();
+      _reachable = false;
+      _leaving = false;
+      return true;
+
+    case postfix_opcode::JMP:
+      if (_leaving) {
+        // tail call: the other function takes over our frame's arguments
+        set_register_arguments();
+        emit(tac_opcode::TAILJMP).label = instruction.sval;
+        _stack.clear();
+        _reachable = false;
+        _leaving = false;
+        return true;
+      }
+      if (!canonicalize() || !jump_to(instruction.sval)) return false;
+      emit(tac_opcode::JMP).label = instruction.sval;
+      _stack.clear();
+      _reachable = false;
+      return true;
+
+    case postfix_opcode::JZ: return branch(tac_condition::EQ, instruction.sval, true);
+    case postfix_opcode::JNZ: return branch(tac_condition::NE, instruction.sval, true);
+    case postfix_opcode::JEQ: return branch(tac_condition::EQ, instruction.sval, false);
+    case postfix_opcode::JNE: return branch(tac_condition::NE, instruction.sval, false);
+    case postfix_opcode::JLT: return branch(tac_condition::LT, instruction.sval, false);
+    case postfix_opcode::JLE: return branch(tac_condition::LE, instruction.sval, false);
+    case postfix_opcode::JGT: return branch(tac_condition::GT, instruction.sval, false);
+    case postfix_opcode::JGE: return branch(tac_condition::GE, instruction.sval, false);
+
+    case postfix_opcode::JTABLE: {
+      if (!pop(value)) return false;
+      int a = materialize(value);
+      if (!canonicalize() || !jump_to(instruction.sval2)) return false;
+      for (auto &label : instruction.labels) {
+        if (!jump_to(label)) return false;
+      }
+      auto &jump = emit(tac_opcode::JTABLE);
+      jump.a = a;
+      jump.b = tac_immediate(0, instruction.sval);
+      jump.label = instruction.sval2;
+      jump.targets = instruction.labels;
+      _stack.clear();
+      _reachable = false;
+      return true;
+    }
+
+    case postfix_opcode::LABEL:
+      return enter_label(instruction.sval);
+
+    default:
+      return fail(std::string("unsupported instruction ") + postfix_buffer::name(instruction.op));
+  }
+}
+
+bool og::tac_builder::build(const std::vector<postfix_instruction> &body) {
+  for (auto &instruction : body) {
+    // code after a jump or a return is dead until the next label
+    if (!_reachable && instruction.op != postfix_opcode::LABEL) continue;
+    if (!process(instruction)) return false;
+  }
+
+  // a final label that nothing jumps to (after an if-else whose branches all return)
+  auto &code = _function.code;
+  if (_reachable && !code.empty() && code.back().op == tac_opcode::LABEL) {
+    bool target = false;
+    for (auto &instruction : code) {
+      bool jump = instruction.op == tac_opcode::JMP || instruction.op == tac_opcode::JCC
+          || instruction.op == tac_opcode::JTABLE;
+      target = target || (jump && instruction.label == code.back().label);
+      for (auto &label : instruction.targets) {
+        target = target || label == code.back().label;
+      }
+    }
+    if (!target) {
+      code.pop_back();
+      _reachable = false;
+    }
+  }
+
+  if (_reachable) {
+    return fail("function does not end with a return");
+  }
+
+  promote_frame_slots();
+  return true;
+}
+
+//---------------------------------------------------------------------------
+//     FRAME SLOT PROMOTION
+//---------------------------------------------------------------------------
+
+void og::tac_builder::promote_frame_slots() {
+  std::set<int> offsets;
+  for (auto &instruction : _function.code) {
+    if (instruction.op == tac_opcode::LOADF || instruction.op == tac_opcode::STOREF) {
+      if (instruction.imm % 4 != 0) return; // overlapping accesses: leave everything in memory
+      offsets.insert(instruction.imm);
+    }
+  }
+
+  std::map<int, int> promoted; // offset -> vreg
+  for (int offset : offsets) {
+    bool escaped = false;
+    for (auto &range : _escaped) {
+      escaped = escaped || (offset >= range.first && offset < range.second);
+    }
+    if (!escaped) promoted[offset] = _function.new_vreg();
+  }
+  if (promoted.empty()) return;
+
+  std::vector<tac_instruction> code;
+  size_t first = 0;
+  while (first < _function.code.size() && _function.code[first].op == tac_opcode::PARAM) {
+    code.push_back(_function.code[first++]);
+  }
+
+  // arguments start in memory (or, after the registers are read, in registers)
+  for (auto &[offset, vreg] : promoted) {
+    if (offset <= 0) continue;
+    tac_instruction load(tac_opcode::LOADF);
+    load.dst = vreg;
+    load.imm = offset;
+    code.push_back(load);
+  }
+
+  for (size_t ix = first; ix < _function.code.size(); ix++) {
+    auto &instruction = _function.code[ix];
+    auto it = promoted.find(instruction.imm);
+    if (instruction.op == tac_opcode::LOADF && it != promoted.end()) {
+      tac_instruction copy(tac_opcode::MOV);
+      copy.dst = instruction.dst;
+      copy.a = it->second;
+      code.push_back(copy);
+    } else if (instruction.op == tac_opcode::STOREF && it != promoted.end()) {
+      if (instruction.b.is_vreg()) {
+        tac_instruction copy(tac_opcode::MOV);
+        copy.dst = it->second;
+        copy.a = instruction.b.vreg;
+        code.push_back(copy);
+      } else if (instruction.b.label.empty()) {
+        tac_instruction copy(tac_opcode::MOVI);
+        copy.dst = it->second;
+        copy.imm = instruction.b.imm;
+        code.push_back(copy);
+      } else {
+        tac_instruction copy(tac_opcode::ADDRESS);
+        copy.dst = it->second;
+        copy.imm = instruction.b.imm;
+        copy.label = instruction.b.label;
+        code.push_back(copy);
+      }
+    } else {
+      if (instruction.op == tac_opcode::TAILJMP) {
+        // ...and end in memory, where the other function reads them (before its register arguments are set)
+        size_t at = code.size();
+        while (at > 0 && code[at - 1].op == tac_opcode::ARG) at--;
+        for (auto &[offset, vreg] : promoted) {
+          if (offset <= 0) continue;
+          tac_instruction store(tac_opcode::STOREF);
+          store.imm = offset;
+          store.b = tac_vreg(vreg);
+          code.insert(code.begin() + at++, store);
+        }
+      }
+      code.push_back(instruction);
+    }
+  }
+
+  _function.code = code;
+}
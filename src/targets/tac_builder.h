@@ -0,0 +1,86 @@
+#ifndef __OG_TARGETS_TAC_BUILDER_H__
+#define __OG_TARGETS_TAC_BUILDER_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "targets/tac.h"
+#include "targets/postfix_buffer.h"
+
+namespace og {
+
+  /**
+   * Translates the postfix code of a function body into three-address code by
+   * simulating the postfix stack symbolically. Values stay virtual (in virtual
+   * registers, or as constants/addresses folded into their users) and are only
+   * pushed onto the machine stack for calls. At labels and jumps, the stack is
+   * kept in per-depth canonical registers.
+   *
+   * Frame slots whose address never escapes are promoted to virtual registers.
+   */
+  class tac_builder {
+    struct stack_value {
+      enum { VREG, IMMEDIATE, FRAME, SYMBOL, MACHINE } kind;
+      int vreg = -1;
+      int imm = 0;       // displacement for VREG, FRAME and SYMBOL
+      std::string label; // SYMBOL only
+    };
+
+    tac_function &_function;
+    std::vector<stack_value> _stack;
+    std::vector<int> _canonical;          // vreg holding the value at each depth across jumps
+    std::map<std::string, size_t> _labels; // stack depth expected at each label
+    bool _reachable = true;
+    bool _leaving = false; // after LEAVE: RET returns, JMP is a tail call
+    std::vector<std::pair<int, int>> _escaped; // frame ranges [first, last) whose address was taken
+    std::vector<tac_operand> _registerArguments; // for the next call (ecx, edx)
+    std::string _error;
+
+  public:
+    tac_builder(tac_function &function) :
+        _function(function) {
+    }
+
+  public:
+    /** Translate a function body (the code after ENTER). Returns false if it uses unsupported operations. */
+    bool build(const std::vector<postfix_instruction> &body);
+
+    const std::string &error() const {
+      return _error;
+    }
+
+  private:
+    bool fail(const std::string &reason) {
+      _error = reason;
+      return false;
+    }
+
+    tac_instruction &emit(tac_opcode op);
+    int binary(tac_opcode op, int a, tac_operand b);
+
+    bool pop(stack_value &value);
+    bool pop_operand(tac_operand &operand);
+    void push_vreg(int vreg);
+    void push_immediate(int imm);
+    int materialize(const stack_value &value);
+    void escape(int offset);
+
+    bool process(const postfix_instruction &instruction);
+    bool arithmetic(postfix_opcode op);
+    bool comparison(tac_condition cond);
+    bool branch(tac_condition cond, const std::string &label, bool compareWithZero);
+    bool load();
+    bool store();
+
+    bool flush_for_call();
+    void set_register_arguments();
+    bool canonicalize();
+    bool jump_to(const std::string &label);
+    bool enter_label(const std::string &label);
+
+    void promote_frame_slots();
+  };
+
+} // og
+
+#endif
@@ -0,0 +1,212 @@
+#include <map>
+#include "targets/tac_optimizer.h"
+
+void og::tac_optimizer::count() {
+  _uses.assign(_function.vregs, 0);
+  _defs.assign(_function.vregs, 0);
+  for (auto &instruction : _function.code) {
+    for (int vreg : instruction.uses()) _uses[vreg]++;
+    if (instruction.dst >= 0) _defs[instruction.dst]++;
+  }
+}
+
+void og::tac_optimizer::run() {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    changed = propagate_copies() || changed;
+    count();
+    changed = retarget() || changed;
+    count();
+    changed = fuse_branches() || changed;
+    count();
+    changed = remove_dead_code() || changed;
+  }
+}
+
+//---------------------------------------------------------------------------
+
+bool og::tac_optimizer::propagate_copies() {
+  bool changed = false;
+  std::map<int, int> copies;    // vreg -> vreg it currently equals
+  std::map<int, int> constants; // vreg -> value it currently holds
+
+  for (auto &instruction : _function.code) {
+    // facts do not survive merge points
+    if (instruction.op == tac_opcode::LABEL) {
+      copies.clear();
+      constants.clear();
+      continue;
+    }
+
+    auto copy = copies.find(instruction.a);
+    if (copy != copies.end()) {
+      instruction.a = copy->second;
+      changed = true;
+    }
+    if (instruction.b.is_vreg()) {
+      copy = copies.find(instruction.b.vreg);
+      auto constant = constants.find(instruction.b.vreg);
+      if (copy != copies.end()) {
+        instruction.b.vreg = copy->second;
+        changed = true;
+      } else if (constant != constants.end()) {
+        instruction.b = tac_immediate(constant->second);
+        changed = true;
+      }
+    }
+    if (instruction.op == tac_opcode::MOV && constants.count(instruction.a)) {
+      instruction.op = tac_opcode::MOVI;
+      instruction.imm = constants[instruction.a];
+      instruction.a = -1;
+      changed = true;
+    }
+
+    int dst = instruction.dst;
+    if (dst < 0) continue;
+
+    constants.erase(dst);
+    copies.erase(dst);
+    for (auto it = copies.begin(); it != copies.end();) {
+      if (it->second == dst) {
+        it = copies.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    if (instruction.op == tac_opcode::MOV && instruction.a != dst) {
+      copies[dst] = instruction.a;
+    } else if (instruction.op == tac_opcode::MOVI) {
+      constants[dst] = instruction.imm;
+    }
+  }
+
+  return changed;
+}
+
+bool og::tac_optimizer::retarget() {
+  bool changed = false;
+  auto &code = _function.code;
+
+  // t = ...; v = t; ... t ...  ==>  v = ...; ... v ...
+  for (size_t ix = 0; ix + 1 < code.size(); ix++) {
+    auto &value = code[ix];
+    auto &copy = code[ix + 1];
+    if (copy.op != tac_opcode::MOV || value.dst < 0 || copy.a != value.dst || copy.dst == value.dst) continue;
+    if (_defs[value.dst] != 1) continue;
+    int t = value.dst, v = copy.dst;
+
+    // any other reads of t must follow in the same block, before v changes
+    int remaining = _uses[t] - 1;
+    size_t end = ix + 2;
+    for (; end < code.size() && remaining > 0 && code[end].op != tac_opcode::LABEL; end++) {
+      for (int vreg : code[end].uses()) {
+        if (vreg == t) remaining--;
+      }
+      if (code[end].dst == v) {
+        end++;
+        break;
+      }
+    }
+    if (remaining != 0) continue;
+
+    for (size_t jx = ix + 2; jx < end; jx++) {
+      if (code[jx].a == t) code[jx].a = v;
+      if (code[jx].b.is_vreg() && code[jx].b.vreg == t) code[jx].b.vreg = v;
+    }
+    _uses[v] += _uses[t] - 1;
+    _uses[t] = 0;
+    value.dst = v;
+    code.erase(code.begin() + ix + 1);
+    changed = true;
+  }
+
+  return changed;
+}
+
+static og::tac_condition invert(og::tac_condition cond) {
+  switch (cond) {
+    case og::tac_condition::EQ: return og::tac_condition::NE;
+    case og::tac_condition::NE: return og::tac_condition::EQ;
+    case og::tac_condition::LT: return og::tac_condition::GE;
+    case og::tac_condition::LE: return og::tac_condition::GT;
+    case og::tac_condition::GT: return og::tac_condition::LE;
+    case og::tac_condition::GE: return og::tac_condition::LT;
+  }
+  return cond;
+}
+
+bool og::tac_optimizer::fuse_branches() {
+  bool changed = false;
+  auto &code = _function.code;
+
+  // t = a cond b; ...; if (t ==/!= 0) goto L  ==>  if (a [!]cond b) goto L
+  for (size_t ix = 0; ix < code.size(); ix++) {
+    auto &set = code[ix];
+    if (set.op != tac_opcode::SET || _uses[set.dst] != 1 || _defs[set.dst] != 1) continue;
+
+    // only copies (stack canonicalization) may separate the comparison from the jump
+    size_t jx = ix + 1;
+    bool clobbered = false;
+    while (jx < code.size() && (code[jx].op == tac_opcode::MOV || code[jx].op == tac_opcode::MOVI)) {
+      int dst = code[jx].dst;
+      clobbered = clobbered || dst == set.a || (set.b.is_vreg() && dst == set.b.vreg) || code[jx].a == set.dst;
+      jx++;
+    }
+    if (clobbered || jx == code.size()) continue;
+
+    auto &jump = code[jx];
+    if (jump.op != tac_opcode::JCC || jump.a != set.dst || jump.b.is_vreg() || !jump.b.label.empty()
+        || jump.b.imm != 0) continue;
+    if (jump.cond != tac_condition::EQ && jump.cond != tac_condition::NE) continue;
+
+    jump.cond = jump.cond == tac_condition::NE ? set.cond : invert(set.cond);
+    jump.a = set.a;
+    jump.b = set.b;
+    code.erase(code.begin() + ix);
+    changed = true;
+  }
+
+  return changed;
+}
+
+bool og::tac_optimizer::remove_dead_code() {
+  bool changed = false;
+  std::vector<tac_instruction> code;
+
+  count();
+  for (auto &instruction : _function.code) {
+    bool pure = false;
+    switch (instruction.op) {
+      case tac_opcode::MOV:
+        if (instruction.dst == instruction.a) {
+          changed = true;
+          continue;
+        }
+        pure = true;
+        break;
+      case tac_opcode::MOVI: case tac_opcode::ADDRESS: case tac_opcode::FRAME:
+      case tac_opcode::LOAD: case tac_opcode::LOADF: case tac_opcode::LOADG:
+      case tac_opcode::ADD: case tac_opcode::SUB: case tac_opcode::MUL:
+      case tac_opcode::AND: case tac_opcode::OR: case tac_opcode::XOR:
+      case tac_opcode::SHL: case tac_opcode::SHR: case tac_opcode::SAR:
+      case tac_opcode::DIV: case tac_opcode::MOD: case tac_opcode::NEG: case tac_opcode::NOT:
+      case tac_opcode::SET: case tac_opcode::RESULT: case tac_opcode::PARAM:
+        pure = true;
+        break;
+      default:
+        break;
+    }
+
+    if (pure && _uses[instruction.dst] == 0) {
+      changed = true;
+      continue;
+    }
+    code.push_back(instruction);
+  }
+
+  _function.code = code;
+  count();
+  return changed;
+}
@@ -0,0 +1,38 @@
+#ifndef __OG_TARGETS_TAC_OPTIMIZER_H__
+#define __OG_TARGETS_TAC_OPTIMIZER_H__
+
+#include <vector>
+#include "targets/tac.h"
+
+namespace og {
+
+  /**
+   * Cleans up the three-address code produced by tac_builder before register
+   * allocation: block-local copy and constant propagation, computing values
+   * directly into the register they are copied to, fusing comparisons into
+   * the conditional jumps that test them, and removing unused computations.
+   */
+  class tac_optimizer {
+    tac_function &_function;
+    std::vector<int> _uses; // number of reads of each virtual register
+    std::vector<int> _defs; // number of writes to each virtual register
+
+  public:
+    tac_optimizer(tac_function &function) :
+        _function(function) {
+    }
+
+  public:
+    void run();
+
+  private:
+    void count();
+    bool propagate_copies();
+    bool retarget();
+    bool fuse_branches();
+    bool remove_dead_code();
+  };
+
+} // og
+
+#endif